@@ -0,0 +1,260 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+struct arSlab {
+    struct arSlab *next;
+    int cls;
+    int live;   // blocks handed out and not yet freed
+    int evac;   // being emptied by a compaction pass
+    char *bump; // next never used block
+};
+
+// blocks start past the header, kept 16 byte aligned
+#define AR_HDR ((sizeof(struct arSlab) + 15) & ~(size_t)15)
+// the reference count in front of the bytes handed out
+#define AR_REF sizeof(int)
+#define AR_REFS(p) (*(int *)((char *)(p) - AR_REF))
+
+static int arClass(size_t n) {
+    int cls = 0;
+    size_t size = (size_t)1 << AR_MIN_SHIFT;
+    while (size < n) {
+        size <<= 1;
+        cls++;
+    }
+    return cls;
+}
+
+static size_t arClassSize(int cls) {
+    return (size_t)1 << (cls + AR_MIN_SHIFT);
+}
+
+static struct arSlab *arSlabOf(void *p) {
+    return (struct arSlab *)((uintptr_t)p & ~(uintptr_t)(AR_SLAB - 1));
+}
+
+static struct arSlab *arNewSlab(struct arena *a, int cls) {
+    void *mem;
+    if (posix_memalign(&mem, AR_SLAB, AR_SLAB) != 0) return NULL;
+
+    struct arSlab *s = mem;
+    s->cls = cls;
+    s->live = 0;
+    s->evac = 0;
+    s->bump = (char *)s + AR_HDR;
+    s->next = a->slabs[cls];
+    a->slabs[cls] = s;
+    a->slabbytes += AR_SLAB;
+    return s;
+}
+
+void arInit(struct arena *a) {
+    int i;
+    for (i = 0; i < AR_CLASSES; i++) {
+        a->slabs[i] = NULL;
+        a->cur[i] = NULL;
+        a->freelist[i] = NULL;
+        a->parked[i] = NULL;
+    }
+    a->slabbytes = 0;
+    a->livebytes = 0;
+    a->freed = 0;
+}
+
+// hand every slab back, blocks bigger than AR_MAX have to be arFree'd first
+void arDestroy(struct arena *a) {
+    int cls;
+    for (cls = 0; cls < AR_CLASSES; cls++) {
+        struct arSlab *s = a->slabs[cls];
+        while (s) {
+            struct arSlab *next = s->next;
+            free(s);
+            s = next;
+        }
+    }
+    arInit(a);
+}
+
+// allocate at least n bytes, *cap is set to what was actually reserved
+void *arAlloc(struct arena *a, size_t n, int *cap) {
+    char *block;
+    size_t size;
+
+    if (n + AR_REF > AR_MAX) {
+        // geometric growth for big rows too, just without the slabs
+        size = AR_MAX;
+        while (size < n + AR_REF) size *= 2;
+        block = malloc(size);
+        if (block == NULL) return NULL;
+    } else {
+        int cls = arClass(n + AR_REF);
+        size = arClassSize(cls);
+        block = a->freelist[cls];
+
+        if (block) {
+            a->freelist[cls] = *(void **)block;
+        } else {
+            struct arSlab *s = a->cur[cls];
+            if (s == NULL || s->bump + size > (char *)s + AR_SLAB) {
+                s = arNewSlab(a, cls);
+                if (s == NULL) return NULL;
+                a->cur[cls] = s;
+            }
+            block = s->bump;
+            s->bump += size;
+        }
+
+        arSlabOf(block)->live++;
+        a->livebytes += size;
+    }
+
+    *(int *)block = 1;
+    *cap = size - AR_REF;
+    return block + AR_REF;
+}
+
+void arRetain(void *p) {
+    AR_REFS(p)++;
+}
+
+int arShared(void *p) {
+    return AR_REFS(p) > 1;
+}
+
+// drop a reference, the block goes back to its slab with the last one
+void arFree(struct arena *a, void *p, int cap) {
+    if (p == NULL || cap == 0) return;
+    if (--AR_REFS(p) > 0) return;
+
+    char *block = (char *)p - AR_REF;
+    size_t size = cap + AR_REF;
+    if (size > AR_MAX) {
+        free(block);
+        return;
+    }
+
+    struct arSlab *s = arSlabOf(block);
+    s->live--;
+    a->livebytes -= size;
+    a->freed += size;
+
+    // blocks in a slab being evacuated are kept aside until it's done
+    void **list = s->evac ? &a->parked[s->cls] : &a->freelist[s->cls];
+    *(void **)block = *list;
+    *list = block;
+}
+
+void *arRealloc(struct arena *a, void *p, int oldcap, size_t n, int *cap) {
+    if (p && n <= (size_t)oldcap) {
+        *cap = oldcap;
+        return p;
+    }
+    if (p && oldcap + AR_REF > AR_MAX) {
+        size_t size = oldcap + AR_REF;
+        while (size < n + AR_REF) size *= 2;
+        char *block = realloc((char *)p - AR_REF, size);
+        if (block == NULL) return NULL;
+        *cap = size - AR_REF;
+        return block + AR_REF;
+    }
+
+    void *new = arAlloc(a, n, cap);
+    if (new == NULL) return NULL;
+    if (p) {
+        memcpy(new, p, oldcap);
+        arFree(a, p, oldcap);
+    }
+    return new;
+}
+
+/*** compaction ***/
+// Compaction works in three steps: arCompactBegin picks out the slabs that
+// are mostly free, the owner moves every block arMoving says is in one of
+// them, and arCompactEnd hands the emptied slabs back. Shared blocks can't
+// be moved, so their slabs simply survive the pass.
+
+// worth a pass once over half of at least 4M of slabs sits unused, and
+// enough has been freed since the last pass that it won't just repeat it
+int arShouldCompact(struct arena *a) {
+    return a->slabbytes >= 16 * AR_SLAB && a->livebytes * 2 < a->slabbytes
+        && a->freed >= a->slabbytes / 4;
+}
+
+int arCompactBegin(struct arena *a) {
+    int marked = 0;
+    int cls;
+
+    for (cls = 0; cls < AR_CLASSES; cls++) {
+        size_t size = arClassSize(cls);
+        int nblocks = (AR_SLAB - AR_HDR) / size;
+        int found = 0;
+        struct arSlab *s;
+
+        // the slab still being bump allocated from is left alone
+        for (s = a->slabs[cls]; s; s = s->next) {
+            if (s != a->cur[cls] && s->live * 2 < nblocks) {
+                s->evac = 1;
+                found++;
+            }
+        }
+        if (!found) continue;
+        marked += found;
+
+        // park the free blocks inside the slabs we are emptying
+        void **link = &a->freelist[cls];
+        while (*link) {
+            void *block = *link;
+            if (arSlabOf(block)->evac) {
+                *link = *(void **)block;
+                *(void **)block = a->parked[cls];
+                a->parked[cls] = block;
+            } else {
+                link = (void **)block;
+            }
+        }
+    }
+    return marked;
+}
+
+int arMoving(struct arena *a, void *p, int cap) {
+    (void)a;
+    if (p == NULL || cap == 0 || cap + AR_REF > AR_MAX) return 0;
+    return AR_REFS(p) == 1 && arSlabOf(p)->evac;
+}
+
+void arCompactEnd(struct arena *a) {
+    int cls;
+    a->freed = 0;
+
+    for (cls = 0; cls < AR_CLASSES; cls++) {
+        // parked blocks in slabs that survived become usable again
+        void *block = a->parked[cls];
+        a->parked[cls] = NULL;
+        while (block) {
+            void *next = *(void **)block;
+            if (arSlabOf(block)->live > 0) {
+                *(void **)block = a->freelist[cls];
+                a->freelist[cls] = block;
+            }
+            block = next;
+        }
+
+        struct arSlab **link = &a->slabs[cls];
+        while (*link) {
+            struct arSlab *s = *link;
+            if (s->evac && s->live == 0) {
+                *link = s->next;
+                a->slabbytes -= AR_SLAB;
+                free(s);
+            } else {
+                s->evac = 0;
+                link = &s->next;
+            }
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*** ROW ARENA ***/
+// Row text is carved out of 256K slabs, each slab holding blocks of a single
+// power of two size class from 16 bytes up to AR_MAX. Capacities are always
+// rounded up to the class size, so rows grow geometrically and most single
+// character edits fit in the block they already have. Anything bigger than
+// AR_MAX goes straight to malloc.
+//
+// Every block starts with a reference count, so the same text can be held
+// by more than one owner (a row and a save snapshot say). arFree drops one
+// reference, and a block with more than one must be copied before writing.
+#define AR_SLAB (256 * 1024)
+#define AR_MIN_SHIFT 4
+#define AR_MAX (16 * 1024)
+#define AR_CLASSES 11
+
+struct arSlab;
+
+struct arena {
+    struct arSlab *slabs[AR_CLASSES];
+    struct arSlab *cur[AR_CLASSES];  // slab still being bump allocated from
+    void *freelist[AR_CLASSES];
+    void *parked[AR_CLASSES];        // free blocks in slabs being compacted
+    size_t slabbytes;
+    size_t livebytes;
+    size_t freed; // bytes freed back to slabs since the last compaction
+};
+
+void arInit(struct arena *a);
+void arDestroy(struct arena *a);
+void *arAlloc(struct arena *a, size_t n, int *cap);
+void *arRealloc(struct arena *a, void *p, int oldcap, size_t n, int *cap);
+void arFree(struct arena *a, void *p, int cap);
+void arRetain(void *p);
+int arShared(void *p);
+
+int arShouldCompact(struct arena *a);
+int arCompactBegin(struct arena *a);
+int arMoving(struct arena *a, void *p, int cap);
+void arCompactEnd(struct arena *a);
+#endif
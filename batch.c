@@ -0,0 +1,106 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "batch.h"
+
+struct batch {
+    char *keys;
+    size_t len;
+    char **files;
+    int nfiles;
+    int next;   // next file to hand out, workers take it with an atomic add
+    int failed;
+};
+
+static void batchFail(struct batch *b, const char *file, int err) {
+    fprintf(stderr, "envy: %s: %s\n", file, strerror(err));
+    __atomic_add_fetch(&b->failed, 1, __ATOMIC_RELAXED);
+}
+
+// one editor per worker, set up afresh for each file it takes
+static void *batchWorker(void *arg) {
+    struct batch *b = arg;
+    struct editorConfig *E = malloc(sizeof(struct editorConfig));
+    int i;
+
+    while ((i = __atomic_fetch_add(&b->next, 1, __ATOMIC_RELAXED)) < b->nfiles) {
+        initEditor(E, BATCH_ROWS, BATCH_COLS);
+        E->draw = 0;
+        if (eOpen(E, b->files[i]) == -1) {
+            batchFail(b, b->files[i], errno);
+        } else {
+            eRunScript(E, b->keys, b->len);
+            if (E->save.err) batchFail(b, b->files[i], E->save.err);
+        }
+        freeEditor(E);
+    }
+    free(E);
+    return NULL;
+}
+
+static int batchLoad(struct batch *b, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+
+    size_t cap = 4096;
+    ssize_t n;
+    b->keys = malloc(cap);
+    b->len = 0;
+    while ((n = read(fd, &b->keys[b->len], cap - b->len)) > 0) {
+        b->len += n;
+        if (b->len == cap) {
+            cap *= 2;
+            b->keys = realloc(b->keys, cap);
+        }
+    }
+    close(fd);
+    return n == -1 ? -1 : 0;
+}
+
+// envy --batch [-j threads] script.keys file..., exits 1 if any file couldn't
+// be opened or saved
+int batchMain(int argc, char *argv[]) {
+    struct batch b;
+    long nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 2;
+
+    if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+        nthreads = atol(argv[i + 1]);
+        i += 2;
+    }
+    if (i >= argc) {
+        fprintf(stderr, "usage: envy --batch [-j threads] script.keys file...\n");
+        return 2;
+    }
+    if (batchLoad(&b, argv[i]) == -1) {
+        perror(argv[i]);
+        return 1;
+    }
+    b.files = &argv[i + 1];
+    b.nfiles = argc - i - 1;
+    b.next = 0;
+    b.failed = 0;
+
+    if (nthreads > b.nfiles) nthreads = b.nfiles;
+    if (nthreads < 1) nthreads = 1;
+    pthread_t *tid = malloc(sizeof(pthread_t) * nthreads);
+    int started = 0;
+    while (started < nthreads
+            && pthread_create(&tid[started], NULL, batchWorker, &b) == 0)
+        started++;
+    if (started == 0) batchWorker(&b);
+    for (i = 0; i < started; i++)
+        pthread_join(tid[i], NULL);
+
+    free(tid);
+    free(b.keys);
+    return b.failed ? 1 : 0;
+}
@@ -0,0 +1,14 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/*** BATCH MODE ***/
+// envy --batch script.keys file... plays the keys in script.keys through an
+// editor on each of the files in turn, with no terminal and nothing drawn,
+// the way they'd have been typed. Whatever the script saves (w or z) goes
+// out through the usual save path. The files are shared out between a
+// worker thread per CPU, each with an editor of its own.
+#define BATCH_ROWS 24 // the screen the editors think they have
+#define BATCH_COLS 80
+
+int batchMain(int argc, char *argv[]);
+#endif
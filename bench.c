@@ -0,0 +1,395 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "terminal.h"
+#include "editor.h"
+#include "arena.h"
+#include "row.h"
+
+/*** BENCHMARKS ***/
+// `make bench` replays keystroke scripts (typing, a paste, o/d storms, a
+// search, a save) against synthetic files from 1MB to 1GB, no terminal
+// needed. open_getline times opening the way envy used to, a getline and
+// a copied row per line, to hold eOpen's mmap up against. Every run
+// happens in a child process of its own so its peak RSS is its alone, and
+// prints one JSON object per line:
+//
+//   {"scenario": "type", "file_bytes": 1048576, "ops": 20000,
+//    "ns_per_op": 2113, "script_ms": 42.3, "open_ms": 1.2, "allocs": 311,
+//    "alloc_bytes": 90112, "peak_rss_kb": 5120}
+//
+// ops is what the scenario counts (keys typed, commands, 1 for a search),
+// the allocations are those made while the script ran, or for the open
+// scenarios while the file was opened. Recorded scripts can be replayed
+// too with -k file.keys.
+#define BENCH_ROWS 24
+#define BENCH_COLS 80
+#define BENCH_TYPE_KEYS 20000
+#define BENCH_PASTE_BYTES (1 << 20)
+#define BENCH_STORM 1000
+
+// the linker sends allocations made by envy through here (-Wl,--wrap)
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t size);
+int __real_posix_memalign(void **p, size_t align, size_t size);
+
+static unsigned long long allocs, allocbytes;
+
+static void benchCount(size_t size) {
+    __atomic_add_fetch(&allocs, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&allocbytes, size, __ATOMIC_RELAXED);
+}
+
+void *__wrap_malloc(size_t size) {
+    benchCount(size);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+    benchCount(n * size);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t size) {
+    benchCount(size);
+    return __real_realloc(p, size);
+}
+
+int __wrap_posix_memalign(void **p, size_t align, size_t size) {
+    benchCount(size);
+    return __real_posix_memalign(p, align, size);
+}
+
+static double benchNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/*** scripts ***/
+struct script {
+    char *keys;
+    size_t len, cap;
+    long ops;
+};
+
+static void benchPut(struct script *s, const char *keys, size_t len) {
+    if (s->len + len > s->cap) {
+        while (s->len + len > s->cap) s->cap = s->cap ? s->cap * 2 : 4096;
+        s->keys = realloc(s->keys, s->cap);
+    }
+    memcpy(&s->keys[s->len], keys, len);
+    s->len += len;
+}
+
+static void benchPuts(struct script *s, const char *keys) {
+    benchPut(s, keys, strlen(keys));
+}
+
+// the same few lines of C over and over with the numbers changing, what
+// both the synthetic files and the typed and pasted text are made of
+static size_t benchLine(char *buf, unsigned *seed) {
+    static const char *words[] = { "alpha", "beta", "gamma", "delta" };
+    *seed = *seed * 1103515245 + 12345;
+    unsigned r = *seed >> 8;
+    return sprintf(buf, "%*sitem_%u = compute(%u, \"%s\"); // %.*s\n",
+            (int)(r % 4) * 4, "", r % 100000, r % 977, words[r % 4],
+            (int)(r % 40), "the quick brown fox jumps over the lazy dog");
+}
+
+static void benchOpen(struct script *s) {
+    s->ops = 1;
+}
+
+static void benchType(struct script *s) {
+    char line[128];
+    unsigned seed = 7;
+    benchPuts(s, "i");
+    while (s->ops < BENCH_TYPE_KEYS) {
+        size_t n = benchLine(line, &seed);
+        line[n - 1] = '\r';
+        benchPut(s, line, n);
+        s->ops += n;
+    }
+    benchPuts(s, "\x1b");
+}
+
+static void benchPaste(struct script *s) {
+    char line[128];
+    unsigned seed = 11;
+    size_t bytes = 0;
+    benchPuts(s, "i\x1b[200~");
+    while (bytes < BENCH_PASTE_BYTES) {
+        size_t n = benchLine(line, &seed);
+        benchPut(s, line, n);
+        bytes += n;
+    }
+    benchPuts(s, "\x1b[201~\x1b");
+    s->ops = 1;
+}
+
+// open a line below and type into it, then delete the lot one at a time
+static void benchStorm(struct script *s) {
+    int i;
+    for (i = 0; i < BENCH_STORM; i++)
+        benchPuts(s, "onew line\x1b");
+    for (i = 0; i < BENCH_STORM; i++)
+        benchPuts(s, "d");
+    s->ops = BENCH_STORM * 2;
+}
+
+static void benchSearch(struct script *s) {
+    benchPuts(s, "/item_4242[0-9] = compute\r");
+    s->ops = 1;
+}
+
+// no regex syntax in it, so it takes the literal path past the DFA
+static void benchSearchLiteral(struct script *s) {
+    benchPuts(s, "/item_42424 = compute\r");
+    s->ops = 1;
+}
+
+static void benchSave(struct script *s) {
+    benchPuts(s, "w");
+    s->ops = 1;
+}
+
+// the open envy had before the mmap: getline and a row copied out of it
+// for each line, though straight into today's row store
+static int benchGetline(struct editorConfig *E, char *filename) {
+    free(E->filename);
+    E->filename = strdup(filename);
+
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) return -1;
+
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t linelen;
+    erow row;
+    while ((linelen = getline(&line, &linecap, fp)) != -1) {
+        if (linelen > 0 && line[linelen - 1] == '\n') linelen--;
+        row.size = linelen;
+        row.chars = arAlloc(&E->arena, linelen + 1, &row.cap);
+        memcpy(row.chars, line, linelen);
+        row.chars[linelen] = '\0';
+        ePutRows(E->numrows, &row, 1, E);
+    }
+    free(line);
+    fclose(fp);
+    E->dirty = 0;
+    return 0;
+}
+
+struct scenario {
+    const char *name;
+    void (*build)(struct script *s);
+    const char *path; // recorded keys to replay instead
+    int (*open)(struct editorConfig *E, char *filename); // eOpen if NULL
+};
+
+static struct scenario builtin[] = {
+    { "open", benchOpen, NULL, NULL },
+    { "open_getline", benchOpen, NULL, benchGetline },
+    { "type", benchType, NULL, NULL },
+    { "paste", benchPaste, NULL, NULL },
+    { "o_d_storm", benchStorm, NULL, NULL },
+    { "search", benchSearch, NULL, NULL },
+    { "search_literal", benchSearchLiteral, NULL, NULL },
+    { "save", benchSave, NULL, NULL },
+};
+
+static int benchLoad(struct script *s, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) return -1;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        benchPut(s, buf, n);
+    close(fd);
+    s->ops = s->len ? s->len : 1;
+    return n == -1 ? -1 : 0;
+}
+
+/*** running ***/
+struct result {
+    long ops;
+    double openns, scriptns;
+    unsigned long long allocs, allocbytes;
+    int large;
+};
+
+// write a file of about bytes of synthetic lines
+static int benchFile(const char *path, size_t bytes) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return -1;
+    char line[128];
+    unsigned seed = 1;
+    size_t n = 0;
+    while (n < bytes) {
+        size_t len = benchLine(line, &seed);
+        if (len > bytes - n) len = bytes - n;
+        fwrite(line, 1, len, fp);
+        n += len;
+    }
+    return fclose(fp);
+}
+
+// the child's side, frames go to /dev/null and the result down out
+static void benchChild(struct scenario *sc, const char *path, int out) {
+    struct script s = { NULL, 0, 0, 0 };
+    struct result r;
+
+    if (sc->path ? benchLoad(&s, sc->path) == -1 : (sc->build(&s), 0)) {
+        perror(sc->path);
+        _exit(1);
+    }
+    int null = open("/dev/null", O_WRONLY);
+    if (null != -1) dup2(null, STDOUT_FILENO);
+
+    struct editorConfig *E = malloc(sizeof(struct editorConfig));
+    initEditor(E, BENCH_ROWS, BENCH_COLS);
+    // the open scenarios are the open, so their allocations count from here
+    int opening = sc->build == benchOpen;
+    unsigned long long a0 = allocs, b0 = allocbytes;
+    double t0 = benchNow();
+    if ((sc->open ? sc->open : eOpen)(E, (char *)path) == -1) {
+        perror(path);
+        _exit(1);
+    }
+    eFrame(E);
+    double t1 = benchNow();
+    if (!opening) {
+        a0 = allocs;
+        b0 = allocbytes;
+    }
+    eRunScript(E, s.keys, s.len);
+    double t2 = benchNow();
+
+    r.ops = s.ops;
+    r.openns = t1 - t0;
+    r.scriptns = opening ? t1 - t0 : t2 - t1;
+    r.allocs = allocs - a0;
+    r.allocbytes = allocbytes - b0;
+    r.large = E->rows.base != NULL;
+    if (write(out, &r, sizeof(r)) != sizeof(r)) _exit(1);
+    _exit(0);
+}
+
+static void benchRun(struct scenario *sc, const char *path, size_t bytes) {
+    int fds[2];
+    if (pipe(fds) == -1) die("pipe");
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) die("fork");
+    if (pid == 0) {
+        close(fds[0]);
+        benchChild(sc, path, fds[1]);
+    }
+    close(fds[1]);
+
+    struct result r;
+    int got = read(fds[0], &r, sizeof(r)) == sizeof(r);
+    close(fds[0]);
+
+    int status;
+    struct rusage ru;
+    if (wait4(pid, &status, 0, &ru) == -1) die("wait4");
+
+    printf("{\"scenario\": \"%s\", \"file_bytes\": %lu", sc->name,
+            (unsigned long)bytes);
+    if (!got) {
+        printf(", \"error\": \"exit status %d\"}\n",
+                WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+        return;
+    }
+    printf(", \"out_of_core\": %s, \"ops\": %ld, \"ns_per_op\": %.0f"
+            ", \"script_ms\": %.3f, \"open_ms\": %.3f, \"allocs\": %llu"
+            ", \"alloc_bytes\": %llu, \"peak_rss_kb\": %ld}\n",
+            r.large ? "true" : "false", r.ops, r.scriptns / r.ops,
+            r.scriptns / 1e6, r.openns / 1e6, r.allocs, r.allocbytes,
+            ru.ru_maxrss);
+}
+
+// 16M, 1G and the like
+static size_t benchSize(const char *s) {
+    char *end;
+    size_t n = strtoul(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': return n << 10;
+        case 'm': case 'M': return n << 20;
+        case 'g': case 'G': return n << 30;
+    }
+    return n;
+}
+
+static void benchUsage() {
+    fprintf(stderr, "usage: envy-bench [-s 1M,16M,...] [-k file.keys]... "
+            "[scenario]...\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    const char *sizes = "1M,16M,100M,256M,1G";
+    struct scenario *run = malloc(sizeof(struct scenario) * (argc
+                + sizeof(builtin) / sizeof(builtin[0])));
+    int nrun = 0;
+    int i, j;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            sizes = argv[++i];
+        } else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            const char *base = strrchr(argv[++i], '/');
+            run[nrun].name = base ? base + 1 : argv[i];
+            run[nrun].build = NULL;
+            run[nrun].path = argv[i];
+            run[nrun].open = NULL;
+            nrun++;
+        } else {
+            for (j = 0; j < (int)(sizeof(builtin) / sizeof(builtin[0])); j++)
+                if (strcmp(argv[i], builtin[j].name) == 0) break;
+            if (j == (int)(sizeof(builtin) / sizeof(builtin[0]))) benchUsage();
+            run[nrun++] = builtin[j];
+        }
+    }
+    if (nrun == 0) {
+        for (j = 0; j < (int)(sizeof(builtin) / sizeof(builtin[0])); j++)
+            run[nrun++] = builtin[j];
+    }
+
+    const char *tmp = getenv("TMPDIR");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/envy-bench-%d.txt",
+            tmp ? tmp : "/tmp", (int)getpid());
+
+    char *list = strdup(sizes);
+    char *tok;
+    for (tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        size_t bytes = benchSize(tok);
+        if (benchFile(path, bytes) == -1) die(path);
+        for (j = 0; j < nrun; j++) {
+            benchRun(&run[j], path, bytes);
+            // the save scenario writes the file back as it was, but a
+            // recorded script could leave anything behind
+            if (run[j].path && j + 1 < nrun && benchFile(path, bytes) == -1)
+                die(path);
+        }
+    }
+    unlink(path);
+    free(list);
+    free(run);
+    return 0;
+}
@@ -1,16 +1,69 @@
 #include <stdlib.h>
 #include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
 #include "buffer.h"
 
-void abAppend(struct abuf *ab, const char *s, int len) {
-    char *new = realloc(ab->b, ab->len + len);
-    
-    if (new == NULL) return;
-    memcpy(&new[ab->len], s, len);
+static int abGrow(struct abuf *ab, int need) {
+    if (ab->len + need <= ab->cap) return 0;
+
+    int cap = ab->cap ? ab->cap : AB_MIN;
+    while (cap < ab->len + need) cap *= 2;
+
+    char *new = realloc(ab->b, cap);
+    if (new == NULL) {
+        ab->err = 1;
+        return -1;
+    }
     ab->b = new;
+    ab->cap = cap;
+    return 0;
+}
+
+int abAppend(struct abuf *ab, const char *s, int len) {
+    if (abGrow(ab, len) == -1) return -1;
+    memcpy(&ab->b[ab->len], s, len);
     ab->len += len;
+    return 0;
+}
+
+// n copies of c
+int abFill(struct abuf *ab, char c, int n) {
+    if (n <= 0) return 0;
+    if (abGrow(ab, n) == -1) return -1;
+    memset(&ab->b[ab->len], c, n);
+    ab->len += n;
+    return 0;
+}
+
+int abPrintf(struct abuf *ab, const char *fmt, ...) {
+    if (abGrow(ab, 1) == -1) return -1;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(&ab->b[ab->len], ab->cap - ab->len, fmt, ap);
+    va_end(ap);
+    if (len < 0) return -1;
+
+    if (ab->len + len >= ab->cap) {
+        // didn't fit, make room for it and the terminator then go again
+        if (abGrow(ab, len + 1) == -1) return -1;
+        va_start(ap, fmt);
+        vsnprintf(&ab->b[ab->len], ab->cap - ab->len, fmt, ap);
+        va_end(ap);
+    }
+    ab->len += len;
+    return 0;
+}
+
+// empty the buffer but hang on to its storage for next time
+void abReset(struct abuf *ab) {
+    ab->len = 0;
+    ab->err = 0;
 }
 
 void abFree(struct abuf *ab) {
     free(ab->b);
+    ab->b = NULL;
+    ab->len = ab->cap = 0;
 }
@@ -1,8 +1,22 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
 /*** APPEND BUFFER ***/
+// Buffers keep their storage between uses (abReset) and grow by doubling.
+// A failed allocation sets err and is also returned as -1, the buffer keeps
+// what it held before the failing call.
+#define AB_MIN 256
+
 struct abuf {
     char *b;
     int len;
+    int cap;
+    int err;
 };
 
-void abAppend(struct abuf *ab, const char *s, int len);
+int abAppend(struct abuf *ab, const char *s, int len);
+int abFill(struct abuf *ab, char c, int n);
+int abPrintf(struct abuf *ab, const char *fmt, ...);
+void abReset(struct abuf *ab);
 void abFree(struct abuf *ab);
+#endif
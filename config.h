@@ -1,12 +1,25 @@
 #define ENVY_VERSION "0.0.1"
 #define ENVY_TAB_STOP 4
 #define ENVY_QUIT_TIMES 2
+// files at least this big are saved from a background thread
+#define ENVY_SAVE_BG_MIN (8 * 1024 * 1024)
+// files at least this big are opened out of core, their lines stay on disk
+// and only the rows around what's being looked at are kept in memory
+#define ENVY_LARGE_MIN (1024LL * 1024 * 1024)
+// leaves of RS_LEAF_MAX rows such a file keeps loaded, edited ones aside
+#define ENVY_LARGE_CACHE 2048
+// memory the undo log may hold on to before it forgets the oldest changes
+#define ENVY_UNDO_BYTES (64 * 1024 * 1024)
+// ms between fdatasyncs of the crash recovery journal while edits go on
+#define ENVY_JOURNAL_SYNC 1000
 
 enum eKey {
     BACKSPACE = 127,
     UP = 1000,
     DOWN,
     LEFT,
-    RIGHT
+    RIGHT,
+    TICK,   // no key, just time to redraw while background work runs
+    PASTE   // start of a bracketed paste, read the text with eReadPaste
 };
 
@@ -0,0 +1,1363 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <termios.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <stdarg.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "terminal.h"
+#include "config.h"
+#include "editorconfig.h"
+#include "buffer.h"
+#include "screen.h"
+#include "search.h"
+#include "regex.h"
+#include "replace.h"
+#include "row.h"
+#include "lineindex.h"
+#include "utf8.h"
+#include "editor.h"
+
+// acts as a constructor for an empty buffer
+#define ABUF_INIT {NULL, 0, 0, 0}
+
+// CTRL Key basically strips the 6 and 7th bit from the key that has been
+// pressed with ctrl, nice!
+#define CTRL_KEY(k) ((k) & 0x1F)
+
+/*** prototypes ***/
+char *ePrompt(struct editorConfig *E, char *prompt,
+        void (*callback)(struct editorConfig *, char *, int));
+void eSetStatusMessage(struct editorConfig *E, const char *fmt, ...);
+
+// OUTPUT
+void eScroll(struct editorConfig *E) {
+    E->rx = 0;
+    if (E->cy < E->numrows) {
+        E->rx = eRowCxToRx(E->cy, rsGet(&E->rows, E->cy), E->cx, E);
+    }
+
+    if (E->cy < E->rowoff) {
+        E->rowoff = E->cy;
+    }
+    if (E->cy >= E->rowoff + E->screenrows) {
+        E->rowoff = E->cy - E->screenrows + 1;
+    }
+    if (E->rx < E->coloff) {
+        E->coloff = E->rx;
+    }
+    if (E->rx >= E->coloff + E->screencols) {
+        E->coloff = E->rx - E->screencols + 1;
+    }
+}
+
+void eDrawRows(struct editorConfig *E, struct screen *scr) {
+    synUpdate(E, E->rowoff + E->screenrows - 1);
+
+    struct rsIter it;
+    erow *row = rsIterStart(&it, &E->rows, E->rowoff);
+    int y;
+    for (y = 0; y < E->screenrows; y++) {
+        int filerow = y + E->rowoff;
+        if (filerow >= E->numrows) {
+            if (E->numrows == 0 && y == E->screenrows / 3) {
+                char welcome[80];
+                int welcomelen = snprintf(welcome, sizeof(welcome),
+                        "Envy Editor -- version %s", ENVY_VERSION);
+                if(welcomelen > E->screencols) welcomelen = E->screencols;
+
+                int padding = (E->screencols - welcomelen) / 2;
+                if (padding) scrPut(scr, y, 0, "~", 1, 0);
+                scrPut(scr, y, padding, welcome, welcomelen, 0);
+            } else {
+                scrPut(scr, y, 0, "~", 1, 0);
+            }
+        } else {
+            int rlen;
+            unsigned char *hl;
+            char *render = eRowRender(filerow, row, &rlen, &hl, E);
+
+            // one put per run of the same colour
+            int b = 0, x = 0;
+            while (b < rlen) {
+                int start = b;
+                unsigned char attr = hl ? synAttr(hl[b]) : 0;
+                while (b < rlen && (hl ? synAttr(hl[b]) : 0) == attr) b++;
+                // never split a character between two runs
+                while (b < rlen && ((unsigned char)render[b] & 0xc0) == 0x80) b++;
+                x = scrPut(scr, y, x, &render[start], b - start, attr);
+            }
+            row = rsIterNext(&it);
+        }
+    }
+}
+
+// n with thousands separators, 18204 -> "18,204"
+void eFormatCount(char *buf, size_t size, int n) {
+    char digits[16];
+    int len = snprintf(digits, sizeof(digits), "%d", n);
+    size_t o = 0;
+    int i;
+    for (i = 0; i < len && o + 2 < size; i++) {
+        if (i && (len - i) % 3 == 0) buf[o++] = ',';
+        buf[o++] = digits[i];
+    }
+    buf[o] = '\0';
+}
+
+void eDrawStatusBar(struct editorConfig *E, struct screen *scr) {
+    // render the status bar
+    int y = E->screenrows;
+    char status[80], rstatus[160];
+    
+	int len = snprintf(status, sizeof(status), "%.20s %s%s",
+            E->filename ? E->filename : "[No Name]",
+            E->dirty ? "[modified]" : "",
+            E->follow.fd != -1 ? "[follow]" : "");
+    char saving[16] = "";
+    if (E->save.active)
+        snprintf(saving, sizeof(saving), "saving %d%% ", svProgress(&E->save));
+    char found[48] = "";
+    if (E->search.cur != -1 && E->search.cur == E->cy) {
+        char k[16] = "?", n[16];
+        int at = srchIndex(&E->search, E->cy);
+        if (at) eFormatCount(k, sizeof(k), at);
+        eFormatCount(n, sizeof(n), srchCount(&E->search));
+        snprintf(found, sizeof(found), "match %s of %s%s ", k, n,
+                E->search.active ? "+" : "");
+    }
+    char lat[48] = "";
+    if (E->lat.show) {
+        char p50[16], p99[16];
+        latFormat(p50, sizeof(p50), latPercentile(&E->lat.hist[LAT_TOTAL], 50));
+        latFormat(p99, sizeof(p99), latPercentile(&E->lat.hist[LAT_TOTAL], 99));
+        snprintf(lat, sizeof(lat), "p50 %s p99 %s ", p50, p99);
+    }
+    // where the cursor is in the file, as :go takes it
+    size_t total = rsOffset(&E->rows, E->numrows);
+    size_t at = rsOffset(&E->rows, E->cy)
+        + (E->cy < E->numrows ? (size_t)E->cx : 0);
+    char pos[40];
+    snprintf(pos, sizeof(pos), "byte %zu %d%% ", at,
+            total ? (int)(at * 100.0 / total) : 0);
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%s%s%s%s%d/%d %s",
+            lat, saving, found, pos, E->cy + 1, E->numrows,
+            E->mode ? "I" : "N");
+
+    if(len > E->screencols) len = E->screencols;
+    scrFill(scr, y, 0, ' ', E->screencols, SCR_REVERSE);
+    scrPut(scr, y, 0, status, len, SCR_REVERSE);
+    if (len + rlen <= E->screencols)
+        scrPut(scr, y, E->screencols - rlen, rstatus, rlen, SCR_REVERSE);
+}
+
+void eDrawMessageBar(struct editorConfig *E, struct screen *scr) {
+    int msglen = strlen(E->statusmsg);
+    if (msglen > E->screencols) msglen = E->screencols;
+    if (msglen)
+        scrPut(scr, E->screenrows + 1, 0, E->statusmsg, msglen, 0);
+}
+
+// Draw the whole frame into the screen grid, but only send the terminal
+// the cells that differ from the last frame
+void eRefreshScreen(struct editorConfig *E) {
+    if (!E->draw) return;
+    long long start = 0;
+    if (E->lat.on) {
+        latDispatched(&E->lat);
+        start = latNow();
+    }
+    eScroll(E);
+
+    struct abuf *ab = &E->frame;
+    abReset(ab);
+
+    scrResize(&E->screen, E->screenrows + 2, E->screencols);
+    scrClear(&E->screen);
+    eDrawRows(E, &E->screen);
+    eDrawStatusBar(E, &E->screen);
+    eDrawMessageBar(E, &E->screen);
+
+    abAppend(ab, "\x1b[?25l", 6);
+    scrFlush(&E->screen, ab);
+
+    // position the cursor 
+    abPrintf(ab, "\x1b[%d;%dH", (E->cy - E->rowoff) + 1,
+            (E->rx - E->coloff) + 1);
+    abAppend(ab, "\x1b[?25h", 6);
+
+    if (ab->err) {
+        // we don't know what made it out, so repaint everything next time
+        E->screen.synced = 0;
+        eSetStatusMessage(E, "Out of memory drawing the screen");
+        return;
+    }
+    
+    long long composed = E->lat.on ? latNow() : 0;
+    write(STDOUT_FILENO, ab->b, ab->len);
+    if (E->lat.on) latFrame(&E->lat, start, composed, ab->len);
+    E->framebytes = ab->len;
+    E->totalbytes += ab->len;
+    E->frames++;
+}
+
+void eSetStatusMessage(struct editorConfig *E, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(E->statusmsg, sizeof(E->statusmsg), fmt, ap);
+    va_end(ap);
+    // up for 5 seconds
+    evTimer(&E->ev, EV_STATUS, E->statusmsg[0] ? 5000 : -1);
+}
+
+// pick the highlighting for the file name, everything gets lexed afresh
+void eSelectSyntax(struct editorConfig *E) {
+    // not for files out of core, it would mean lexing all of the file above
+    // the screen
+    E->syntax = E->rows.base ? NULL : synSelect(E->filename);
+    E->hlvalid = 0;
+    E->rgen++;
+}
+
+/*** Editor Ops ***/
+void eInsertChar(struct editorConfig *E, int c) {
+    if (E->cy == E->numrows)
+        eInsertRow(E->numrows, "", 0, E);
+
+    eRowInsertChar(E->cy, E->cx, c, E);
+    E->cx++;
+}
+
+void eInsertNewLine(struct editorConfig *E) {
+    if (E->cx == 0) {
+        eInsertRow(E->cy, "", 0, E);
+    } else {
+        eGapClose(E);
+        erow *row = rsGet(&E->rows, E->cy);
+        eInsertRow(E->cy + 1, &row->chars[E->cx], row->size - E->cx, E);
+        eRowTruncate(E->cy, E->cx, E);
+    }
+    E->cy++;
+    E->cx = 0;
+}
+
+void eDelChar(struct editorConfig *E) {
+    if (E->cy == E->numrows) return;
+    if (E->cx == 0 && E->cy == 0) return;
+
+    erow *row = rsGet(&E->rows, E->cy);
+    if (E->cx > 0) {
+        // the whole of a multibyte character goes
+        int prev = eRowPrev(E->cy, row, E->cx, E);
+        eRowDelete(E->cy, prev, E->cx - prev, E);
+        E->cx = prev;
+    } else {
+        eGapClose(E);
+        erow *prev = rsGet(&E->rows, E->cy - 1);
+        E->cx = prev->size;
+        eRowAppendString(E->cy - 1, row->chars, row->size, E);
+        eDelRow(E->cy, E);
+        E->cy--;
+    }
+}
+
+// a bracketed paste goes in as one batch of rows with a single redraw
+// after it, rather than a keypress per byte
+void ePaste(struct editorConfig *E) {
+    size_t len;
+    char *text = eReadPaste(E, &len);
+
+    // terminals send newlines in a paste as \r
+    size_t i, n = 0;
+    for (i = 0; i < len; i++) {
+        if (text[i] == '\r') {
+            text[n++] = '\n';
+            if (i + 1 < len && text[i + 1] == '\n') i++;
+        } else {
+            text[n++] = text[i];
+        }
+    }
+
+    if (E->cy == E->numrows)
+        eInsertRow(E->numrows, "", 0, E);
+
+    char *nl = memchr(text, '\n', n);
+    if (nl == NULL) {
+        eRowInsert(E->cy, E->cx, text, n, E);
+        E->cx += n;
+        free(text);
+        return;
+    }
+
+    // the first line goes on the end of the cursor's row, everything after
+    // the cursor moves down to the end of the last
+    eGapClose(E);
+    erow *row = rsGet(&E->rows, E->cy);
+    size_t taillen = row->size - E->cx;
+    char *tail = malloc(taillen + 1);
+    memcpy(tail, &row->chars[E->cx], taillen);
+    eRowTruncate(E->cy, E->cx, E);
+    eRowInsert(E->cy, E->cx, text, nl - text, E);
+
+    int rows = eInsertLines(E->cy + 1, nl + 1, n - (nl + 1 - text), E);
+    E->cy += rows;
+    E->cx = rsGet(&E->rows, E->cy)->size;
+    eRowAppendString(E->cy, tail, taillen, E);
+
+    free(tail);
+    free(text);
+}
+
+/*** file i/o ***/
+// write out the journal's records for the frame, arming a timer to sync
+// them if nothing else comes along to
+static void eJournalFlush(struct editorConfig *E) {
+    if (jnFlush(&E->jn, E->numrows, E->cx, E->cy) == -1) {
+        eSetStatusMessage(E, "Journal write failed, no longer journaling: %s",
+                strerror(errno));
+        jnClose(&E->jn, 0);
+        return;
+    }
+    if (E->jn.unsynced && !evArmed(&E->ev, EV_JOURNAL))
+        evTimer(&E->ev, EV_JOURNAL, ENVY_JOURNAL_SYNC);
+}
+
+// start journaling the file just opened, offering to recover the changes
+// in a journal an envy that never got to quit left behind
+static void eJournalOpen(struct editorConfig *E) {
+    char aside[NAME_MAX + 1];
+    int c;
+    switch (jnOpen(&E->jn, E->filename)) {
+        case JN_BUSY:
+            eSetStatusMessage(E, "File open in another envy, not journaling");
+            break;
+        case JN_STALE:
+            if (jnSetAside(&E->jn, aside, sizeof(aside)) == 0) {
+                eSetStatusMessage(E, "Journal for an older version kept as %s",
+                        aside);
+            } else {
+                jnClose(&E->jn, 0);
+                eSetStatusMessage(E, "Journal for an older version left as is, "
+                        "not journaling");
+            }
+            break;
+        case JN_FOUND:
+            eSetStatusMessage(E, "Recover unsaved changes from the journal? (y/n)");
+            do {
+                eRefreshScreen(E);
+                c = eReadKey(E);
+            } while (c == TICK);
+            if (c == 'y' || c == 'Y') {
+                int n = jnReplay(&E->jn, E);
+                eSetStatusMessage(E, "%d changes recovered", n);
+            } else {
+                jnDiscard(&E->jn);
+                eSetStatusMessage(E, "");
+            }
+            break;
+    }
+}
+
+// the file read into memory of our own, not mapped from it, so that nothing
+// truncating the file can pull the bytes the rows borrow out from under them
+// (the next look at one would be a SIGBUS). Sets *len to what was read, the
+// file may have shrunk since it was measured.
+static char *eReadFile(int fd, size_t size, size_t *len) {
+    char *buf = mmap(NULL, size, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) return NULL;
+
+    size_t got = 0;
+    while (got < size) {
+        ssize_t n = read(fd, buf + got, size - got);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) {
+            int saved = errno;
+            munmap(buf, size);
+            errno = saved;
+            return NULL;
+        }
+        if (n == 0) break;
+        got += n;
+    }
+    // pages past a file that shrank go back, the rest is read only
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t keep = (got + page - 1) / page * page;
+    if (keep < size) munmap(buf + keep, size - keep);
+    if (got) mprotect(buf, got, PROT_READ);
+    *len = got;
+    return got ? buf : NULL;
+}
+
+// the file is read in whole and rows point straight into that copy until
+// they are edited, so opening costs a read and one pass over the file to find
+// newlines. Files of ENVY_LARGE_MIN and up are mapped instead and don't get a
+// row per line at all, the row store reads their lines from the map as they
+// are needed (see rsMap). Returns -1 with errno set if the file can't be
+// read.
+int eOpen(struct editorConfig *E, char *filename) {
+    free(E->filename);
+    E->filename = strdup(filename);
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return -1;
+    }
+
+    if (st.st_size >= ENVY_LARGE_MIN) {
+        char *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        E->map = map;
+        E->maplen = st.st_size;
+    } else if (st.st_size > 0) {
+        errno = 0;
+        E->map = eReadFile(fd, st.st_size, &E->maplen);
+        if (E->map == NULL && errno) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (E->map && E->maplen >= ENVY_LARGE_MIN) {
+        size_t nblocks, i;
+        struct liBlock *b = liBlocks(E->map, E->maplen, RS_LEAF_MAX, &nblocks);
+        long long lines = 0;
+        for (i = 0; i < nblocks; i++)
+            lines += b[i].lines;
+        if (lines > INT_MAX) {
+            free(b);
+            close(fd);
+            errno = EFBIG;
+            return -1;
+        }
+        rsMap(&E->rows, E->map, b, nblocks, ENVY_LARGE_CACHE);
+        E->numrows = lines;
+        E->mapfd = fd;
+        free(b);
+    } else if (E->map) {
+        size_t nlines;
+        size_t *nl = liScan(E->map, E->maplen, &nlines);
+        eMapRows(E->map, E->maplen, nl, nlines, E);
+        free(nl);
+    }
+    if (E->mapfd != fd) close(fd);
+    flMark(&E->follow, E->map, E->maplen);
+    eSelectSyntax(E);
+
+    // reset the "dirtiness" of the file
+    E->dirty = 0;
+    if (E->jn.on) eJournalOpen(E);
+    return 0;
+}
+
+// Rows are snapshotted and streamed out through save.c, from a thread if
+// the file is big enough for it to matter. eSaveCheck finishes the job off
+// once the writer is done.
+void eSave(struct editorConfig *E) {
+    struct saveJob *job = &E->save;
+    if (job->active) {
+        eSetStatusMessage(E, "Save already in progress");
+        return;
+    }
+
+    if (E->filename == NULL) 
+        E->filename = ePrompt(E, "Filename: %s", NULL);
+    // If the prompt was aborted we are NULL again
+    if (E->filename == NULL) {
+        eSetStatusMessage(E, "Aborted");
+        return;
+    }
+    if (E->syntax == NULL) eSelectSyntax(E);
+    // the records up to here are what's being saved
+    if (E->jn.fd != -1) {
+        eJournalFlush(E);
+        E->jn.mark = E->jn.size;
+    }
+
+    free(job->filename);
+    job->filename = strdup(E->filename);
+    if (E->rows.base) {
+        job->rows = eRowsPieces(E, &job->pieces, &job->npieces, &job->nrows);
+        job->src = E->mapfd;
+    } else {
+        job->rows = eRowsSnapshot(E);
+        job->nrows = E->numrows;
+    }
+    job->dirty = E->dirty;
+    job->total = job->written = 0;
+    job->done = 0;
+    job->err = 0;
+
+    int i;
+    for (i = 0; i < job->nrows; i++)
+        job->total += job->rows[i].size + 1;
+    for (i = 0; i < job->npieces; i++)
+        if (job->pieces[i].n == 0)
+            job->total += job->pieces[i].len + job->pieces[i].nl;
+
+    if (job->total >= ENVY_SAVE_BG_MIN) {
+        svStart(job);
+    } else {
+        job->active = 1;
+        svWrite(job);
+    }
+    eSaveCheck(E);
+}
+
+void eSaveCheck(struct editorConfig *E) {
+    struct saveJob *job = &E->save;
+    if (!job->active || !svDone(job)) return;
+
+    svWait(job);
+    eRowsRelease(job->rows, job->nrows, E);
+    job->rows = NULL;
+    free(job->pieces);
+    job->pieces = NULL;
+    job->npieces = 0;
+    job->active = 0;
+
+    if (job->err) {
+        eSetStatusMessage(E, "Error writing to disk: %s", strerror(job->err));
+        return;
+    }
+
+    eSetStatusMessage(E, "%lu bytes written to disk",
+            (unsigned long)job->total);
+    if (E->jn.fd != -1 && jnRebase(&E->jn, job->filename) == -1)
+        eSetStatusMessage(E, "Journal rewrite failed: %s", strerror(errno));
+    // the file is now what was saved, every row with a newline
+    E->follow.off = E->follow.lineoff = job->total;
+    // and a new inotify fd watching it, flStart stops following on failure
+    if (E->follow.fd != -1) {
+        if (flStart(&E->follow, job->filename) == -1) {
+            E->ev.watch = -1;
+            eSetStatusMessage(E, "Can't follow %s, stopped following: %s",
+                    job->filename, strerror(errno));
+        } else {
+            E->ev.watch = E->follow.fd;
+        }
+    }
+    // reset the "dirtiness" of the file, unless it changed while we saved
+    if (E->dirty == job->dirty) E->dirty = 0;
+}
+
+// let a background save finish, before quitting say
+void eSaveWait(struct editorConfig *E) {
+    if (!E->save.active) return;
+    svWait(&E->save);
+    eSaveCheck(E);
+}
+
+/*** follow ***/
+// the mapping of an out of core file past the end it has been truncated to
+static void eMapCut(struct editorConfig *E) {
+    struct stat st;
+    if (fstat(E->mapfd, &st) == -1) st.st_size = 0;
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t from = ((size_t)st.st_size + page - 1) / page * page;
+    if (from < E->maplen)
+        mmap(E->map + from, E->maplen - from, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+}
+
+// read the next part of the file being followed onto the end of the buffer.
+// That isn't a change of the user's, so it isn't undone and leaves the
+// buffer as clean as it was.
+static int eFollowRead(struct editorConfig *E) {
+    size_t len, part;
+    char *buf = flRead(&E->follow, &len, &part);
+    if (buf == NULL) return -1;
+    if (len == part) {
+        free(buf);
+        return 0;
+    }
+
+    int bottom = E->cy >= E->numrows - 1;
+    int dirty = E->dirty;
+    int at = E->numrows;
+    size_t skip = part;
+    if (part && at > 0) {
+        // the file's unfinished last line comes again with what follows
+        // it, it replaces the row holding it unless that was edited
+        size_t old = buf[part - 1] == '\r' ? part - 1 : part;
+        eGapClose(E);
+        erow *row = rsGet(&E->rows, at - 1);
+        if ((size_t)row->size == old && memcmp(row->chars, buf, old) == 0) {
+            eRowsRelease(eTakeRows(at - 1, 1, E), 1, E);
+            at--;
+            skip = 0;
+        }
+    }
+
+    // as eOpen reads them, no row after a last newline and no '\r' at the
+    // end of a last line without one
+    const char *text = buf + skip;
+    size_t n = len - skip;
+    if (text[n - 1] == '\n' || text[n - 1] == '\r') n--;
+    int count;
+    erow *rows = eSplitLines(text, n, &count, E);
+    ePutRows(at, rows, count, E);
+    free(rows);
+    free(buf);
+
+    E->dirty = dirty;
+    if (bottom) {
+        E->cy = E->numrows - 1;
+        E->cx = 0;
+    }
+    // an unedited buffer is the file as it is now, nothing to recover
+    if (!dirty && E->jn.fd != -1 && !E->save.active) {
+        eJournalFlush(E);
+        if (E->jn.fd != -1) {
+            E->jn.mark = E->jn.size;
+            if (jnRebase(&E->jn, E->filename) == -1)
+                eSetStatusMessage(E, "Journal rewrite failed: %s",
+                        strerror(errno));
+        }
+    }
+    return 0;
+}
+
+// throw the rows away and open the file again, once it's been truncated or
+// replaced under an unedited buffer
+static int eReload(struct editorConfig *E) {
+    char *filename = strdup(E->filename);
+    int bottom = E->cy >= E->numrows - 1;
+    int journal = E->jn.on;
+
+    eSaveWait(E);
+    srchStop(&E->search);
+    // nothing may be left pointing into the map
+    regOwn(E);
+    unFree(E);
+    jnClose(&E->jn, 1);
+    E->jn.on = journal;
+    eFreeRows(E);
+    rsInit(&E->rows);
+    if (E->map) munmap(E->map, E->maplen);
+    E->map = NULL;
+    E->maplen = 0;
+    if (E->mapfd != -1) close(E->mapfd);
+    E->mapfd = -1;
+    E->hlvalid = 0;
+
+    int err = eOpen(E, filename);
+    free(filename);
+    if (bottom || E->cy >= E->numrows) E->cy = E->numrows ? E->numrows - 1 : 0;
+    E->cx = 0;
+    E->rowoff = E->coloff = 0;
+    return err;
+}
+
+static void eFollowStop(struct editorConfig *E) {
+    flStop(&E->follow);
+    E->ev.watch = -1;
+}
+
+// see what the followed file did, called each frame while it has news.
+// One FL_READ_MAX read at most goes in per frame, so the screen keeps up
+// while a lot of it comes in.
+static void eFollowCheck(struct editorConfig *E) {
+    int change = flCheck(&E->follow, E->filename);
+    switch (change) {
+        case FL_SAME:
+            return;
+        case FL_GROWN:
+            if (eFollowRead(E) == -1) {
+                eFollowStop(E);
+                eSetStatusMessage(E, "Can't read %s, stopped following: %s",
+                        E->filename, strerror(errno));
+                return;
+            }
+            E->follow.pending = 1;
+            evTimer(&E->ev, EV_FOLLOW, 0);
+            return;
+    }
+
+    const char *what = change == FL_TRUNCATED ? "truncated" : "replaced";
+    if (E->dirty) {
+        eFollowStop(E);
+        if (change == FL_TRUNCATED && E->rows.base) {
+            // unedited rows past the new end are gone with the file, so the
+            // pages past its end are swapped for zeros rather than being
+            // left to fault on the next look
+            eMapCut(E);
+            eSetStatusMessage(E, "File truncated, stopped following to "
+                    "keep changes, unedited lines past its end are lost");
+            return;
+        }
+        eSetStatusMessage(E, "File %s, stopped following to keep changes",
+                what);
+        return;
+    }
+    if (eReload(E) == -1 || flStart(&E->follow, E->filename) == -1) {
+        eFollowStop(E);
+        eSetStatusMessage(E, "Can't open %s, stopped following: %s",
+                E->filename, strerror(errno));
+        return;
+    }
+    E->ev.watch = E->follow.fd;
+    eSetStatusMessage(E, "File %s, read it again", what);
+}
+
+// F starts following the file from the end, and stops it again
+void eFollow(struct editorConfig *E) {
+    if (E->follow.fd != -1) {
+        eFollowStop(E);
+        eSetStatusMessage(E, "Stopped following");
+        return;
+    }
+    if (E->filename == NULL) {
+        eSetStatusMessage(E, "No file to follow");
+        return;
+    }
+    if (flStart(&E->follow, E->filename) == -1) {
+        eSetStatusMessage(E, "Can't follow %s: %s", E->filename,
+                strerror(errno));
+        return;
+    }
+    E->ev.watch = E->follow.fd;
+    E->cy = E->numrows ? E->numrows - 1 : 0;
+    E->cx = 0;
+    eSetStatusMessage(E, "Following, F to stop");
+}
+
+/*** search and find ***/
+// The first match shown for a query is the nearest one at or below where
+// the find started. Until the workers have got that far there is nothing
+// to show, so the ticks that come in meanwhile keep asking again.
+void eFindCallback(struct editorConfig *E, char *query, int key) {
+    struct search *s = &E->search;
+    int row;
+
+    if (key == '\x1b') {
+        srchStop(s);
+        return;
+    } else if (key == '\r') {
+        // the scan for the last key may have been cut short by this one
+        if (s->cur != -1) return;
+        srchRun(s, query, 0, E);
+        row = srchNearest(s, s->origin - 1, 1, 1);
+    } else if ((key == DOWN || key == UP) && s->cur != -1) {
+        srchRun(s, query, 1, E);
+        row = srchNearest(s, E->cy, key == DOWN ? 1 : -1, 0);
+    } else if (key == TICK || key == DOWN || key == UP) {
+        if (s->cur != -1) return;
+        srchRun(s, query, 1, E);
+        row = srchNearest(s, s->origin - 1, 1, 0);
+    } else {
+        s->cur = -1;
+        srchRun(s, query, 1, E);
+        row = srchNearest(s, s->origin - 1, 1, 0);
+    }
+
+    if (row == -1) return;
+
+    erow *match = rsGet(&E->rows, row);
+    int col = srchCol(s, match->chars, match->size);
+    s->cur = row;
+    E->cy = row;
+    E->cx = col > 0 ? col : 0;
+    E->rowoff = E->numrows;
+}
+
+void eFind(struct editorConfig *E) {
+    int saved_cx = E->cx;
+    int saved_cy = E->cy;
+    int saved_coloff = E->coloff;
+	int saved_rowoff = E->rowoff;
+
+    E->search.origin = E->cy;
+    E->search.cur = -1;
+    char *query = ePrompt(E, "Find: %s", eFindCallback);
+
+    if (query) {
+		free(query);
+	} else {
+		E->cx = saved_cx;
+		E->cy = saved_cy;
+		E->coloff = saved_coloff;
+		E->rowoff = saved_rowoff;
+	}
+}
+
+/*** goto ***/
+// to the start of line n, counting from 1
+void eGotoLine(struct editorConfig *E, long n) {
+    if (n < 1) n = 1;
+    E->cy = n > E->numrows ? E->numrows - 1 : n - 1;
+    if (E->cy < 0) E->cy = 0;
+    E->cx = 0;
+}
+
+// to byte pos of the file as it would be saved, counting from 0 the way
+// grep -b and the like do. Both are a walk down the row store's byte sums.
+void eGotoByte(struct editorConfig *E, size_t pos) {
+    size_t start;
+    int at = rsRowAt(&E->rows, pos, &start);
+    if (at == -1) return;
+
+    eGapClose(E);
+    erow *row = rsGet(&E->rows, at);
+    size_t cx = pos - start;
+    if (cx > (size_t)row->size) cx = row->size;
+    // not into the middle of a character, the end of a row borrowed from
+    // the map may be the end of the map
+    while (cx > 0 && cx < (size_t)row->size
+            && ((unsigned char)row->chars[cx] & 0xc0) == 0x80)
+        cx--;
+    E->cy = at;
+    E->cx = cx;
+}
+
+// a number as typed after a :, 0x for hex
+static int eNumber(const char *s, unsigned long long *n) {
+    char *end;
+    while (*s == ' ') s++;
+    if (!isdigit((unsigned char)*s)) return 0;
+    errno = 0;
+    *n = strtoull(s, &end, s[0] == '0' && (s[1] == 'x' || s[1] == 'X')
+            ? 16 : 10);
+    while (*end == ' ') end++;
+    return errno == 0 && *end == '\0';
+}
+
+// copy of s up to the first delim not escaped by a \, which a \ before
+// it stands for when unescape is set, with *s left past that delim
+static char *eField(const char **s, int delim, int unescape) {
+    const char *p = *s;
+    char *out = malloc(strlen(p) + 1);
+    size_t n = 0;
+    while (*p && *p != delim) {
+        if (*p == '\\' && p[1] == delim && unescape) p++;
+        else if (*p == '\\' && p[1]) out[n++] = *p++;
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+    *s = *p ? p + 1 : p;
+    return out;
+}
+
+// s/pattern/replacement/g on the cursor's line, %s/... on all of them, any
+// punctuation will do for the /. An empty pattern is the last search.
+void eSubstitute(struct editorConfig *E, const char *cmd) {
+    int all = cmd[0] == '%';
+    const char *p = cmd + all + 1;
+    int delim = (unsigned char)*p;
+    if (!ispunct(delim) || delim == '\\' || delim == '"') {
+        eSetStatusMessage(E, "Usage: :s/pattern/replacement/g");
+        return;
+    }
+    p++;
+    char *pattern = eField(&p, delim, 1);
+    char *rep = eField(&p, delim, 0);
+    int global = 0;
+    for (; *p; p++) {
+        if (*p == 'g') {
+            global = 1;
+        } else {
+            eSetStatusMessage(E, "Unknown flag: %c", *p);
+            goto done;
+        }
+    }
+    if (pattern[0] == '\0' && E->search.query) {
+        free(pattern);
+        pattern = strdup(E->search.query);
+    }
+
+    struct regex *re = pattern[0] ? reCompile(pattern) : NULL;
+    if (re == NULL) {
+        eSetStatusMessage(E, pattern[0] ? "Bad pattern: %s" : "No pattern",
+                pattern);
+        goto done;
+    }
+
+    struct rplStats st;
+    long long t0 = latNow();
+    if (all) rplRun(E, re, rep, global, 0, E->numrows - 1, &st);
+    else rplRun(E, re, rep, global, E->cy, E->cy, &st);
+    double ms = (latNow() - t0) / 1e6;
+    reFree(re);
+
+    if (st.count == 0) {
+        eSetStatusMessage(E, "Pattern not found: %s", pattern);
+        goto done;
+    }
+    E->cy = st.last;
+    E->cx = 0;
+    eSetStatusMessage(E, "%ld substitution%s on %d line%s in %.1f ms",
+            st.count, st.count == 1 ? "" : "s", st.lines,
+            st.lines == 1 ? "" : "s", ms);
+done:
+    free(pattern);
+    free(rep);
+}
+
+// the commands typed after a :
+void eCommand(struct editorConfig *E) {
+    char *cmd = ePrompt(E, ":%s", NULL);
+    if (cmd == NULL) return;
+
+    unsigned long long n;
+    size_t len = strcspn(cmd, " ");
+    if (eNumber(cmd, &n)) {
+        eGotoLine(E, n > LONG_MAX ? LONG_MAX : (long)n);
+    } else if (len >= 2 && strncmp(cmd, "goto", len) == 0) {
+        // :go and :goto, or anything in between
+        if (eNumber(cmd + len, &n)) eGotoByte(E, n);
+        else eSetStatusMessage(E, "Usage: :go offset");
+    } else if (cmd[0] == 's' || (cmd[0] == '%' && cmd[1] == 's')) {
+        eSubstitute(E, cmd);
+    } else {
+        eSetStatusMessage(E, "Not a command: %s", cmd);
+    }
+    free(cmd);
+}
+
+/** input **/
+char *ePrompt(struct editorConfig *E, char *prompt,
+        void (*callback)(struct editorConfig *, char *, int)) {
+    size_t bufsize = 128;
+    char *buf = malloc(bufsize);
+
+    size_t buflen = 0;
+    buf[0] = '\0';
+
+    while (1) {
+        eSetStatusMessage(E, prompt, buf);
+        if (!eInputPending(E)) eRefreshScreen(E);
+
+        int c = eReadKey(E);
+        if (c == TICK) {
+            if (callback) callback(E, buf, c);
+            continue;
+        } else if (c == BACKSPACE || c == CTRL_KEY('h')) {
+            if (buflen != 0) {
+                buflen = u8Prev(buf, buflen);
+                buf[buflen] = '\0';
+            }
+        } else if (c == '\x1b') {
+            eSetStatusMessage(E, "");
+            if (callback) callback(E, buf, c);
+            free(buf);
+            return NULL;
+        } else if (c == '\r') {
+            if (buflen != 0) {
+                eSetStatusMessage(E, "");
+                if (callback) callback(E, buf, c);
+                return buf;
+            }
+        } else if (c == PASTE) {
+            size_t len, i;
+            char *text = eReadPaste(E, &len);
+            for (i = 0; i < len && text[i] != '\r' && text[i] != '\n'; i++) {
+                if (iscntrl((unsigned char)text[i])) continue;
+                if (buflen == bufsize - 1) {
+                    bufsize *= 2;
+                    buf = realloc(buf, bufsize);
+                }
+                buf[buflen++] = text[i];
+            }
+            buf[buflen] = '\0';
+            free(text);
+        } else if (c >= 128 ? c < 256 : !iscntrl(c)) {
+            if (buflen == bufsize - 1) {
+                bufsize *= 2;
+                buf = realloc(buf, bufsize);
+            }
+            buf[buflen++] = c;
+            buf[buflen] = '\0';
+        }
+
+        if (callback) callback(E, buf, c);
+    }
+}
+
+void eMoveCursor(struct editorConfig *E, int key) {
+    // get the current row
+    erow *row = rsGet(&E->rows, E->cy);
+    // up and down keep to the same screen column rather than byte
+    int rx = row ? eRowCxToRx(E->cy, row, E->cx, E) : 0;
+    int vertical = 0;
+
+    switch(key) {
+        case LEFT:
+		case 'h':
+            if (row && E->cx != 0)
+                E->cx = eRowPrev(E->cy, row, E->cx, E);
+            break;
+        case DOWN:
+		case 'j':
+            if (E->cy < E->numrows)
+                E->cy++;
+            vertical = 1;
+            break;
+        case UP:
+		case 'k':
+            if (E->cy != 0)
+                E->cy--;
+            vertical = 1;
+            break;
+        case RIGHT:
+		case 'l':
+            if (row && E->cx < row->size)
+                E->cx = eRowNext(E->cy, row, E->cx, E);
+            break;
+    }
+
+    // move the cursor if we are beyond the line we end up on
+    row = rsGet(&E->rows, E->cy);
+    if (vertical && row) E->cx = erowRxToCx(E->cy, row, rx, E);
+    int rowlen = row ? row->size : 0;
+    if (E->cx > rowlen)
+        E->cx = rowlen;
+}
+
+void eProcessKeypress(struct editorConfig *E) {
+    int c = eReadKey(E);
+    if (c == TICK) return;
+    // whatever this key changes is undone in one go
+    unStep(&E->undo);
+
+    if (E->mode) { // insert mode
+        switch(c) {
+            case '\r':
+                eInsertNewLine(E);
+                break;
+
+            case BACKSPACE:
+            case CTRL_KEY('h'):
+                eDelChar(E);
+                break;
+
+            case RIGHT:
+            case LEFT:
+            case DOWN:
+            case UP:
+                eMoveCursor(E, c);
+                break;
+
+            case '\x1b':
+                E->mode = 0;
+                break;
+
+            case PASTE:
+                ePaste(E);
+                break;
+
+            default:
+                eInsertChar(E, c);
+                break;
+        }
+    } else { // normal mode 
+        // a count and register typed ahead of a command only last for it
+        if ((c >= '1' && c <= '9') || (c == '0' && E->count)) {
+            if (E->count < 10000000) E->count = E->count * 10 + c - '0';
+            return;
+        }
+        if (c == '"') {
+            do c = eReadKey(E); while (c == TICK);
+            E->reg = regIndex(c);
+            return;
+        }
+        int given = E->count;
+        int count = given ? given : 1;
+        int reg = E->reg;
+        E->count = 0;
+        E->reg = 0;
+
+        switch(c) {
+            case 'd':
+                if (E->cy >= E->numrows) break;
+                regYank(E, reg, E->cy, count);
+                eDelRows(E->cy, count, E);
+                if (E->cy >= E->numrows && E->cy > 0) E->cy = E->numrows - 1;
+                eMoveCursor(E, 0);
+                if (count > 2)
+                    eSetStatusMessage(E, "%d fewer lines", E->regs[reg].n);
+                break;
+
+			case 'y':
+                if (E->cy >= E->numrows) break;
+                regYank(E, reg, E->cy, count);
+                if (count > 2)
+                    eSetStatusMessage(E, "%d lines yanked", E->regs[reg].n);
+				break;
+
+			case 'p':
+			case 'P':
+                {
+                    int at = c == 'p' && E->cy < E->numrows ? E->cy + 1 : E->cy;
+                    int n = 0;
+                    while (count--) n += regPut(E, reg, at + n);
+                    if (n == 0) {
+                        eSetStatusMessage(E, "Nothing in register");
+                        break;
+                    }
+                    E->cy = at > E->numrows - n ? E->numrows - n : at;
+                    E->cx = 0;
+                    if (n > 2) eSetStatusMessage(E, "%d more lines", n);
+                }
+				break;
+
+			case 'O':
+				E->cy--;
+			case 'o':
+				if (E->cy > E->numrows) E->cy--;
+				{
+					erow *row = rsGet(&E->rows, E->cy);
+					E->cx = row ? row->size : 0;
+				}
+				eInsertNewLine(E);
+				E->mode = 1;
+				break;
+ 
+            case '/':
+                eFind(E);
+                break;
+
+			case 'g':
+				E->cy = 0;
+				break;
+			case 'G':
+                if (given) eGotoLine(E, given);
+                else E->cy = E->numrows - 1;
+				break;
+
+            case ':':
+                eCommand(E);
+                break;
+
+            case 'i':
+                E->mode = 1;
+                break;
+
+            case 'u':
+                if (!unUndo(E))
+                    eSetStatusMessage(E, "Already at oldest change");
+                break;
+
+            case CTRL_KEY('r'):
+                if (!unRedo(E))
+                    eSetStatusMessage(E, "Already at newest change");
+                break;
+
+			case 'h':
+			case 'j':
+			case 'k':
+			case 'l':
+            case RIGHT:
+            case LEFT:
+            case DOWN:
+            case UP:
+                eMoveCursor(E, c);
+                break;
+
+            case '\x1b':
+                E->mode = 0;
+                break;
+
+            case 'w':
+                eSave(E);
+                break;
+
+            case PASTE:
+                ePaste(E);
+                break;
+
+            case CTRL_KEY('g'):
+                eSetStatusMessage(E,
+                        "last frame %d bytes, %lu bytes over %lu frames",
+                        E->framebytes, E->totalbytes, E->frames);
+                break;
+
+            case 'F':
+                eFollow(E);
+                break;
+
+            case CTRL_KEY('t'):
+                latStart(&E->lat);
+                E->lat.show = E->lat.on && !E->lat.show;
+                break;
+
+            case 'x':
+				// find current row, move right, remove char
+                // TODO
+				break;
+
+            case 'z':
+				eSave(E);
+				eSaveWait(E);
+				E->quit = 1;
+				break;
+
+            case 'q':
+                if (E->dirty) {
+                    eSetStatusMessage(E, "File changed. "
+                      "Press Q to quit without saving.");
+                    return;
+                }
+            case 'Q':
+                eSaveWait(E);
+                E->quit = 1;
+                break;
+
+        }
+    }
+}
+
+// init
+
+// an editor on a screen of rows by cols, the terminal is left alone
+void initEditor(struct editorConfig *E, int rows, int cols) {
+    E->cx = 0;
+    E->cy = 0;
+    E->rx = 0;
+    E->rowoff = 0;
+    E->coloff = 0;
+
+    E->numrows = 0;
+    rsInit(&E->rows);
+    arInit(&E->arena);
+    E->render = NULL;
+    E->nrender = 0;
+    E->rgen = 0;
+    {
+        int i;
+        for (i = 0; i < ROW_COLCACHE; i++) {
+            E->cols[i].row = -1;
+            E->cols[i].n = E->cols[i].cap = 0;
+            E->cols[i].at = NULL;
+        }
+    }
+    E->prefix = NULL;
+    E->prefixcap = 0;
+    E->rowhl = NULL;
+    E->rowhlcap = 0;
+    E->gaprow = -1;
+    E->gap = E->gaplen = 0;
+    E->syntax = NULL;
+    E->hlvalid = 0;
+    E->dirty = 0;
+
+    E->filename = NULL;
+    E->map = NULL;
+    E->maplen = 0;
+    E->mapfd = -1;
+    svInit(&E->save);
+    unInit(&E->undo);
+    jnInit(&E->jn);
+    {
+        int i;
+        for (i = 0; i < REG_COUNT; i++) {
+            E->regs[i].rows = NULL;
+            E->regs[i].n = 0;
+        }
+    }
+    E->reg = 0;
+    E->count = 0;
+    srchInit(&E->search);
+    struct abuf frame = ABUF_INIT;
+    E->frame = frame;
+    E->framebytes = 0;
+    E->totalbytes = 0;
+    E->frames = 0;
+    latInit(&E->lat);
+    flInit(&E->follow);
+
+    // status line and commadn line
+    E->screenrows = rows - 2;
+    E->screencols = cols;
+    scrInit(&E->screen);
+
+    // status message
+    E->statusmsg[0] = '\0';
+    // no SIGWINCH pipe, the tty's editor gets one from evInit (see envy.c)
+    {
+        int i;
+        for (i = 0; i < EV_TIMERS; i++)
+            E->ev.due[i] = 0;
+    }
+    E->ev.pipe[0] = E->ev.pipe[1] = -1;
+    E->ev.watch = -1;
+    E->in.script = NULL;
+    E->in.pos = E->in.len = 0;
+    E->draw = 1;
+    E->quit = 0;
+
+    E->mode = 0;
+}
+
+// free everything the editor holds, it can be initEditor'd again after
+void freeEditor(struct editorConfig *E) {
+    int i;
+
+    eSaveWait(E);
+    srchFree(&E->search);
+    svFree(&E->save);
+    for (i = 0; i < REG_COUNT; i++)
+        regFree(E, &E->regs[i]);
+    unFree(E);
+    jnClose(&E->jn, 0);
+    flStop(&E->follow);
+    eFreeRows(E);
+    arDestroy(&E->arena);
+    scrFree(&E->screen);
+    abFree(&E->frame);
+    latFree(&E->lat);
+    free(E->filename);
+    E->filename = NULL;
+
+    if (E->map) munmap(E->map, E->maplen);
+    E->map = NULL;
+    if (E->mapfd != -1) close(E->mapfd);
+    E->mapfd = -1;
+    for (i = 0; i < 2; i++)
+        if (E->ev.pipe[i] != -1) close(E->ev.pipe[i]);
+}
+
+// what comes before each batch of keys: finishing off background work that
+// is done and drawing the frame
+void eFrame(struct editorConfig *E) {
+    // nothing holds on to rows between keys, so this is when leaves of
+    // a file out of core can go back to disk
+    rsTrim(&E->rows);
+    if (E->follow.pending) eFollowCheck(E);
+    if (E->jn.fd != -1) eJournalFlush(E);
+    eSaveCheck(E);
+    srchPoll(&E->search);
+    eRefreshScreen(E);
+}
+
+// play keys through the editor without a terminal, a frame per key the way
+// they'd come in typed, then let any save or search they set off finish
+void eRunScript(struct editorConfig *E, const char *keys, size_t len) {
+    eReplay(E, len ? keys : "", len);
+    while (!E->quit && eInputPending(E)) {
+        eFrame(E);
+        eProcessKeypress(E);
+    }
+    eReplay(E, NULL, 0);
+    eSaveWait(E);
+    srchWait(&E->search);
+    eFrame(E);
+}
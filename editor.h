@@ -0,0 +1,24 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+#include <stddef.h>
+
+#include "editorconfig.h"
+
+/*** EDITOR ***/
+// The editor proper, everything but the terminal. Each editorConfig is an
+// editor of its own with nothing shared between them, so there can be one
+// per thread. envy.c runs one on the tty, while anything handing them keys
+// from memory (batch mode in batch.c, the benchmarks in bench.c) goes
+// through eRunScript.
+void initEditor(struct editorConfig *E, int rows, int cols);
+void freeEditor(struct editorConfig *E);
+int eOpen(struct editorConfig *E, char *filename);
+void eSave(struct editorConfig *E);
+void eSaveCheck(struct editorConfig *E);
+void eSaveWait(struct editorConfig *E);
+void eRefreshScreen(struct editorConfig *E);
+void eProcessKeypress(struct editorConfig *E);
+void eFrame(struct editorConfig *E);
+void eRunScript(struct editorConfig *E, const char *keys, size_t len);
+#endif
@@ -2,9 +2,30 @@
 #define EDITORCONFIG_H
 
 #include <termios.h>
+#include <stddef.h>
 #include <time.h>
 
-#include "erow.h"
+#include "rowstore.h"
+#include "arena.h"
+#include "screen.h"
+#include "save.h"
+#include "search.h"
+#include "syntax.h"
+#include "undo.h"
+#include "register.h"
+#include "event.h"
+#include "latency.h"
+#include "journal.h"
+#include "follow.h"
+
+// keys read ahead of what eReadKey has handed out so far, they come in a
+// buffer full at a time rather than a read() each (see terminal.c)
+struct input {
+    char buf[4096];
+    int pos, len;
+    const char *script; // keys played back from memory instead, see eReplay
+    size_t scriptlen, scriptpos;
+};
 
 struct editorConfig {
     int cx, cy;
@@ -14,12 +35,45 @@ struct editorConfig {
     int screenrows;
     int screencols;
     int numrows;
-    erow *row;
+    struct rowStore rows;
+    struct arena arena; // chars and render storage for rows
+    struct renderSlot *render;
+    int nrender;
+    unsigned rgen;      // bumped on every row change, stales the render slots
+    struct colIndex cols[ROW_COLCACHE];
+    char *prefix;       // eRowPrefix's copy of a row from around the gap
+    int prefixcap;
+    unsigned char *rowhl; // highlighting of the row eRowRender is lexing
+    int rowhlcap;
+    int gaprow;         // the row with a gap in its chars, -1 for none
+    int gap, gaplen;    // where the gap starts and how long it is
+    struct syntax *syntax; // NULL when the file type has no highlighting
+    int hlvalid;        // rows before this have up to date lexer states
     int dirty;
+    struct undoLog undo;
+    struct journal jn;
+    struct follow follow;
+    struct reg regs[REG_COUNT];
+    int reg;            // register picked for the next command with "x
+    int count;          // count typed ahead of the next command, 0 for none
     char *filename;
+    struct saveJob save;
+    struct search search;
+    char *map;        // the file as read (or mapped) that rows borrow from
+    size_t maplen;
+    int mapfd;        // kept open for files opened out of core, saves copy from it
     struct termios origTermios;
-    char statusmsg[80];
-    time_t statusmsg_time;
+    struct input in;
+    int draw;                  // 0 to run without drawing anything at all
+    int quit;                  // set by the commands that quit
+    struct screen screen;
+    struct abuf frame;         // escape sequences for a frame, reused each time
+    int framebytes;            // bytes sent to the terminal for the last frame
+    unsigned long totalbytes;
+    unsigned long frames;
+    struct latency lat;
+    char statusmsg[80];        // cleared by the EV_STATUS timer
+    struct evLoop ev;
 	int mode; // 0 for N, 1 for I
 };
 #endif
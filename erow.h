@@ -1,7 +1,46 @@
+#ifndef EROW_H
+#define EROW_H
+
 typedef struct erow {
     int size;
-    int rsize;
+    int cap; // bytes reserved for chars, 0 while chars points into the file map
     char *chars;
-    char *render;
+    unsigned char hlin;  // lexer state the row was highlighted from
+    unsigned char hlend; // and the one it ended in, see syntax.h
 } erow;
 
+// tab expanded copy of the on screen part of a row and its highlighting,
+// see eRowRender
+struct renderSlot {
+    int row;
+    unsigned gen;
+    int coloff, cols; // the window it was rendered for
+    int len;
+    int cap;
+    char *buf;
+    int hlcap;
+    unsigned char *hl;
+};
+
+// Display columns of long rows, as the byte offset and column of a
+// character every ROW_COLSTEP bytes or so, so mapping cx to rx and back
+// only scans from the nearest checkpoint. Built lazily as far as it has
+// been asked about, and an edit only throws away the checkpoints after it.
+#define ROW_COLSTEP 256
+#define ROW_COLMIN 1024 // rows shorter than this are just scanned
+#define ROW_COLCACHE 64 // indexes kept, row `at` uses slot at % ROW_COLCACHE
+
+struct colIndex {
+    int row;  // -1 while unused
+    int n, cap;
+    int *at;  // n pairs of byte offset, column
+};
+
+// Rows at least ROW_GAPMIN long that are being typed into keep a gap in
+// their chars at the last edit (E->gaprow, gap, gaplen), so typing and
+// deleting at the cursor moves no more than the distance the cursor went
+// rather than the rest of the row. Only one row has a gap at a time, and
+// it is closed up again (eGapClose) before anything outside row.c looks
+// at chars.
+#define ROW_GAPMIN 4096
+#endif
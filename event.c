@@ -0,0 +1,98 @@
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "event.h"
+#include "terminal.h"
+
+// the handler only gets to see a global
+static int winchfd = -1;
+
+static void evOnWinch(int sig) {
+    (void)sig;
+    int saved = errno;
+    write(winchfd, "w", 1);
+    errno = saved;
+}
+
+static long long evNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void evInit(struct evLoop *ev) {
+    int i;
+    for (i = 0; i < EV_TIMERS; i++)
+        ev->due[i] = 0;
+    ev->watch = -1;
+
+    ev->pipe[0] = ev->pipe[1] = -1;
+    if (pipe(ev->pipe) == -1) return;
+    for (i = 0; i < 2; i++) {
+        fcntl(ev->pipe[i], F_SETFL, fcntl(ev->pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(ev->pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+    winchfd = ev->pipe[1];
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = evOnWinch;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGWINCH, &sa, NULL);
+}
+
+// fire timer id in ms from now, or with ms < 0 not at all
+void evTimer(struct evLoop *ev, int id, int ms) {
+    ev->due[id] = ms < 0 ? 0 : evNow() + ms;
+}
+
+int evArmed(struct evLoop *ev, int id) {
+    return ev->due[id] != 0;
+}
+
+// block until fd is readable (EV_INPUT), the window changed size
+// (EV_RESIZE), a timer is due (EV_TIMER, with its id in *timer, and the
+// timer is disarmed) or ev->watch is readable (EV_WATCH)
+int evWait(struct evLoop *ev, int fd, int *timer) {
+    while (1) {
+        long long now = evNow();
+        long long next = 0;
+        int i;
+        for (i = 0; i < EV_TIMERS; i++) {
+            if (ev->due[i] == 0) continue;
+            if (ev->due[i] <= now) {
+                ev->due[i] = 0;
+                *timer = i;
+                return EV_TIMER;
+            }
+            if (next == 0 || ev->due[i] < next) next = ev->due[i];
+        }
+
+        // poll() passes over the ones that are -1
+        struct pollfd pfd[3] = {
+            { fd, POLLIN, 0 },
+            { ev->pipe[0], POLLIN, 0 },
+            { ev->watch, POLLIN, 0 }
+        };
+        int n = poll(pfd, 3, next ? (int)(next - now) : -1);
+        if (n == -1 && errno != EINTR) die("poll");
+        if (n <= 0) continue; // a timer came due or a signal got in first
+
+        if (pfd[1].revents & POLLIN) {
+            char buf[64];
+            while (read(ev->pipe[0], buf, sizeof(buf)) > 0)
+                ;
+            return EV_RESIZE;
+        }
+        if (pfd[0].revents) return EV_INPUT;
+        if (pfd[2].revents) return EV_WATCH;
+    }
+}
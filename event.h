@@ -0,0 +1,35 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+/*** EVENTS ***/
+// The editor sleeps in poll() until a key comes in, a signal arrives or a
+// timer is due, rather than waking the terminal up every 100ms to ask.
+// SIGWINCH is turned into a byte down a pipe so it wakes poll() the same
+// way input does. Timers are one shot deadlines, one per id. One more fd
+// can be watched alongside the terminal, the inotify one of follow.h.
+enum evTimerId {
+    EV_STATUS, // the status message has been up long enough
+    EV_TICK,   // redraw while a save or search runs in the background
+    EV_JOURNAL, // time the journal's last writes were synced
+    EV_FOLLOW, // more of the followed file to read than one frame's worth
+    EV_TIMERS
+};
+
+enum evType {
+    EV_INPUT,
+    EV_RESIZE,
+    EV_TIMER,
+    EV_WATCH
+};
+
+struct evLoop {
+    int pipe[2];                // written to by the SIGWINCH handler
+    long long due[EV_TIMERS];   // ms on the monotonic clock, 0 when unset
+    int watch;                  // readable makes EV_WATCH, -1 for none
+};
+
+void evInit(struct evLoop *ev);
+void evTimer(struct evLoop *ev, int id, int ms);
+int evArmed(struct evLoop *ev, int id);
+int evWait(struct evLoop *ev, int fd, int *timer);
+#endif
@@ -0,0 +1,133 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include "follow.h"
+
+void flInit(struct follow *f) {
+    f->fd = -1;
+    f->file = -1;
+    f->wd = f->dirwd = -1;
+    f->dev = 0;
+    f->ino = 0;
+    f->off = f->lineoff = 0;
+    f->pending = 0;
+}
+
+// the buffer now holds the len bytes of data as the whole file
+void flMark(struct follow *f, const char *data, size_t len) {
+    const char *nl = len ? memrchr(data, '\n', len) : NULL;
+    f->off = len;
+    f->lineoff = nl ? nl + 1 - data : 0;
+}
+
+// start watching path, picking up from f->off, -1 with errno set if it
+// can't be
+int flStart(struct follow *f, const char *path) {
+    struct stat st;
+    int saved;
+
+    flStop(f);
+    f->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (f->fd == -1) return -1;
+    f->file = open(path, O_RDONLY | O_CLOEXEC);
+    if (f->file == -1 || fstat(f->file, &st) == -1) goto fail;
+    f->dev = st.st_dev;
+    f->ino = st.st_ino;
+
+    f->wd = inotify_add_watch(f->fd, path, IN_MODIFY | IN_ATTRIB
+            | IN_MOVE_SELF | IN_DELETE_SELF);
+    if (f->wd == -1) goto fail;
+    // a new file by the same name shows up in the directory
+    char *copy = strdup(path);
+    f->dirwd = inotify_add_watch(f->fd, dirname(copy),
+            IN_CREATE | IN_MOVED_TO);
+    free(copy);
+    if (f->dirwd == -1) goto fail;
+
+    // whatever was written since the file was read
+    f->pending = 1;
+    return 0;
+
+fail:
+    saved = errno;
+    flStop(f);
+    errno = saved;
+    return -1;
+}
+
+void flStop(struct follow *f) {
+    if (f->fd != -1) close(f->fd);
+    if (f->file != -1) close(f->file);
+    f->fd = f->file = -1;
+    f->wd = f->dirwd = -1;
+    f->pending = 0;
+}
+
+// read the events that woke the loop, flCheck works out what they meant
+void flDrain(struct follow *f) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    while (f->fd != -1 && read(f->fd, buf, sizeof(buf)) > 0)
+        f->pending = 1;
+}
+
+// how the file has changed since off. New bytes in the file we have open
+// come before a rotation, so it is read to the end first.
+int flCheck(struct follow *f, const char *path) {
+    struct stat st;
+    f->pending = 0;
+    if (f->file == -1 || fstat(f->file, &st) == -1) return FL_SAME;
+    if (st.st_size < f->off) return FL_TRUNCATED;
+    if (st.st_size > f->off) return FL_GROWN;
+
+    if (stat(path, &st) == -1) return FL_SAME; // until the new one arrives
+    if (st.st_dev != f->dev || st.st_ino != f->ino) return FL_ROTATED;
+    return FL_SAME;
+}
+
+// Read the next bytes of the file in a malloc'd buffer of *len, starting
+// with the *part bytes of its last line the buffer already holds. Moves
+// off and lineoff past them. NULL on an error.
+char *flRead(struct follow *f, size_t *len, size_t *part) {
+    struct stat st;
+    *len = *part = 0;
+    if (fstat(f->file, &st) == -1) return NULL;
+
+    off_t start = f->lineoff;
+    off_t end = st.st_size;
+    if (end - f->off > FL_READ_MAX) end = f->off + FL_READ_MAX;
+    if (end < f->off) end = f->off;
+
+    size_t want = end - start;
+    char *buf = malloc(want ? want : 1);
+    size_t got = 0;
+    while (got < want) {
+        ssize_t n = pread(f->file, buf + got, want - got, start + got);
+        if (n == -1 && errno == EINTR) continue;
+        if (n == -1) {
+            free(buf);
+            return NULL;
+        }
+        if (n == 0) break; // truncated since the fstat
+        got += n;
+    }
+    if (got < (size_t)(f->off - start)) {
+        // not even what was there before, flCheck will see it's shorter
+        *len = 0;
+        return buf;
+    }
+
+    *part = f->off - start;
+    *len = got;
+    const char *nl = got > *part ? memrchr(buf + *part, '\n', got - *part) : NULL;
+    f->off = start + got;
+    if (nl) f->lineoff = start + (nl + 1 - buf);
+    return buf;
+}
@@ -0,0 +1,44 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*** FOLLOW ***/
+// Following a file that is being appended to, a log say. inotify watches
+// the file for writes and its directory for a new file taking its name,
+// and wakes the event loop (see evLoop.watch). Only the bytes past what
+// the buffer already holds are read, at most FL_READ_MAX at a time, along
+// with the file's last line again if it had no newline yet, since that is
+// the line the new bytes carry on. The file stays open, so whatever is
+// written to it after it is renamed away still gets read before moving on
+// to the new one.
+#define FL_READ_MAX (16 << 20)
+
+enum flChange {
+    FL_SAME,
+    FL_GROWN,     // there are bytes past off to read
+    FL_TRUNCATED, // the file is shorter than off
+    FL_ROTATED    // another file has taken the name, this one is read out
+};
+
+struct follow {
+    int fd;         // inotify, -1 when not following
+    int file;       // the file being followed
+    int wd, dirwd;
+    dev_t dev;
+    ino_t ino;
+    // kept up to date by eOpen and saves while not following too
+    off_t off;      // bytes of the file the buffer holds
+    off_t lineoff;  // where its last line starts, off if it ended in '\n'
+    int pending;    // something happened since the last flCheck
+};
+
+void flInit(struct follow *f);
+void flMark(struct follow *f, const char *data, size_t len);
+int flStart(struct follow *f, const char *path);
+void flStop(struct follow *f);
+void flDrain(struct follow *f);
+int flCheck(struct follow *f, const char *path);
+char *flRead(struct follow *f, size_t *len, size_t *part);
+#endif
@@ -0,0 +1,505 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "editorconfig.h"
+#include "row.h"
+#include "journal.h"
+
+#define JN_FNV 2166136261u
+
+// a record as read back, a to d its numbers in order
+struct jnRec {
+    int type;
+    unsigned long long a, b, c, d;
+    const char *text; // the text, or for 'a' the first row's length
+    size_t len;
+};
+
+void jnInit(struct journal *j) {
+    j->on = 0;
+    j->fd = -1;
+    j->path = NULL;
+    memset(j->id, 0, sizeof(j->id));
+    j->buf.b = NULL;
+    j->buf.len = j->buf.cap = j->buf.err = 0;
+    j->hash = JN_FNV;
+    j->size = j->mark = 0;
+    j->pending = 0;
+    j->unsynced = 0;
+    j->synced = 0;
+    j->err = 0;
+    j->replaying = 0;
+}
+
+static long long jnNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static unsigned jnHash(unsigned h, const char *s, size_t len) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void jnPut64(unsigned char *p, unsigned long long v) {
+    int i;
+    for (i = 0; i < 8; i++)
+        p[i] = v >> (8 * i);
+}
+
+// what the header says about the file: size, mtime and inode
+static int jnIdentify(const char *filename, unsigned char *id) {
+    struct stat st;
+    if (stat(filename, &st) == -1) return -1;
+    jnPut64(id, st.st_size);
+    jnPut64(id + 8, st.st_mtim.tv_sec);
+    jnPut64(id + 16, st.st_mtim.tv_nsec);
+    jnPut64(id + 24, st.st_ino);
+    return 0;
+}
+
+static void jnHeader(struct journal *j, char *out) {
+    memcpy(out, JN_MAGIC, 8);
+    memcpy(out + 8, j->id, sizeof(j->id));
+}
+
+static int jnPwrite(int fd, const char *s, size_t len, off_t off) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, s, len, off);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        s += n;
+        len -= n;
+        off += n;
+    }
+    return 0;
+}
+
+// .name.envyj in the same directory as the file, symlinks followed
+static char *jnPath(const char *filename) {
+    char *target = realpath(filename, NULL);
+    if (target == NULL) target = strdup(filename);
+    char *dircopy = strdup(target);
+    char *basecopy = strdup(target);
+    char *dir = dirname(dircopy);
+    char *base = basename(basecopy);
+
+    size_t len = strlen(dir) + strlen(base) + 16;
+    char *path = malloc(len);
+    snprintf(path, len, "%s/.%s.envyj", dir, base);
+    free(basecopy);
+    free(dircopy);
+    free(target);
+    return path;
+}
+
+// open (or start) the journal for filename and lock it as ours. Journaling
+// carries on unless that fails or it comes back JN_BUSY, with JN_STALE the
+// caller should jnSetAside it and with JN_FOUND jnReplay or jnDiscard it.
+int jnOpen(struct journal *j, const char *filename) {
+    if (jnIdentify(filename, j->id) == -1) return JN_NONE;
+
+    char *path = jnPath(filename);
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        free(path);
+        return JN_NONE;
+    }
+    if (flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        close(fd);
+        free(path);
+        return JN_BUSY;
+    }
+    j->fd = fd;
+    j->path = path;
+
+    struct stat st;
+    char header[JN_HEADER], want[JN_HEADER];
+    jnHeader(j, want);
+    if (fstat(fd, &st) == -1 || st.st_size <= JN_HEADER) {
+        jnDiscard(j);
+        return JN_NONE;
+    }
+    j->size = st.st_size;
+    if (pread(fd, header, JN_HEADER, 0) != JN_HEADER
+            || memcmp(header, want, JN_HEADER) != 0)
+        return JN_STALE;
+    return JN_FOUND;
+}
+
+// start the journal over, empty, for the file as it is now
+int jnDiscard(struct journal *j) {
+    char header[JN_HEADER];
+    jnHeader(j, header);
+    abReset(&j->buf);
+    j->hash = JN_FNV;
+    j->pending = 0;
+    j->size = JN_HEADER;
+    j->unsynced = 1;
+    if (jnPwrite(j->fd, header, JN_HEADER, 0) == -1
+            || ftruncate(j->fd, JN_HEADER) == -1) {
+        j->err = errno;
+        return -1;
+    }
+    return 0;
+}
+
+/*** writing ***/
+static int jnWrite(struct journal *j) {
+    if (j->buf.len == 0) return 0;
+    if (jnPwrite(j->fd, j->buf.b, j->buf.len, j->size) == -1) {
+        j->err = errno;
+        abReset(&j->buf);
+        return -1;
+    }
+    j->size += j->buf.len;
+    j->unsynced = 1;
+    abReset(&j->buf);
+    return 0;
+}
+
+static void jnBytes(struct journal *j, const char *s, size_t len, int hashed) {
+    if (abAppend(&j->buf, s, len) == -1) j->err = ENOMEM;
+    if (hashed) j->hash = jnHash(j->hash, s, len);
+}
+
+static void jnVarint(struct journal *j, unsigned long long v, int hashed) {
+    char b[10];
+    int n = 0;
+    do {
+        b[n] = v & 0x7f;
+        v >>= 7;
+        if (v) b[n] |= 0x80;
+        n++;
+    } while (v);
+    jnBytes(j, b, n, hashed);
+}
+
+static void jnStart(struct journal *j, char type) {
+    jnBytes(j, &type, 1, 1);
+    j->pending = 1;
+}
+
+// big records go out before the frame ends rather than piling up
+static void jnEnd(struct journal *j) {
+    if (j->buf.len >= JN_BUF) jnWrite(j);
+}
+
+void jnInsert(struct journal *j, int row, int col, const char *s, int len) {
+    if (j->replaying || len <= 0) return;
+    jnStart(j, 'i');
+    jnVarint(j, row, 1);
+    jnVarint(j, col, 1);
+    jnVarint(j, len, 1);
+    jnBytes(j, s, len, 1);
+    jnEnd(j);
+}
+
+void jnDelete(struct journal *j, int row, int col, int n) {
+    if (j->replaying || n <= 0) return;
+    jnStart(j, 'd');
+    jnVarint(j, row, 1);
+    jnVarint(j, col, 1);
+    jnVarint(j, n, 1);
+    jnEnd(j);
+}
+
+void jnAddRows(struct journal *j, int at, const erow *rows, int n) {
+    if (j->replaying || n <= 0) return;
+    jnStart(j, 'a');
+    jnVarint(j, at, 1);
+    jnVarint(j, n, 1);
+    int i;
+    for (i = 0; i < n; i++) {
+        jnVarint(j, rows[i].size, 1);
+        jnBytes(j, rows[i].chars, rows[i].size, 1);
+        if (j->buf.len >= JN_BUF) jnWrite(j);
+    }
+}
+
+void jnDelRows(struct journal *j, int at, int n) {
+    if (j->replaying || n <= 0) return;
+    jnStart(j, 'r');
+    jnVarint(j, at, 1);
+    jnVarint(j, n, 1);
+    jnEnd(j);
+}
+
+// close off the records since the last checkpoint with another and write
+// them out, syncing if it has been ENVY_JOURNAL_SYNC ms since last time
+int jnFlush(struct journal *j, int numrows, int cx, int cy) {
+    if (j->pending) {
+        jnBytes(j, "c", 1, 0);
+        jnVarint(j, numrows, 0);
+        jnVarint(j, cx, 0);
+        jnVarint(j, cy, 0);
+        jnVarint(j, j->hash, 0);
+        j->hash = JN_FNV;
+        j->pending = 0;
+    }
+    jnWrite(j);
+    if (!j->err && j->unsynced && jnNow() - j->synced >= ENVY_JOURNAL_SYNC) {
+        if (fdatasync(j->fd) == -1) j->err = errno;
+        j->synced = jnNow();
+        j->unsynced = 0;
+    }
+    if (j->err) {
+        errno = j->err;
+        return -1;
+    }
+    return 0;
+}
+
+// a save of the file finished, the records made before it started (up to
+// j->mark) are in the file now. Rewrites the journal as the ones since.
+int jnRebase(struct journal *j, const char *filename) {
+    if (jnIdentify(filename, j->id) == -1) return -1;
+
+    size_t tail = j->size - j->mark;
+    char *data = malloc(JN_HEADER + tail);
+    jnHeader(j, data);
+    int ok = pread(j->fd, data + JN_HEADER, tail, j->mark) == (ssize_t)tail
+        && jnPwrite(j->fd, data, JN_HEADER + tail, 0) == 0
+        && ftruncate(j->fd, JN_HEADER + tail) == 0;
+    free(data);
+    if (!ok) {
+        j->err = errno;
+        return -1;
+    }
+    j->size = JN_HEADER + tail;
+    j->mark = j->size;
+    j->unsynced = 1;
+    return 0;
+}
+
+// keep the journal as it is under .name.envyj.old (.old.2 and on if that is
+// taken, none is ever written over) and start a new one in its place, for a
+// journal found stale: a touch or a checkout changes the file without the
+// edits in the journal being any less wanted. The name kept goes in aside.
+int jnSetAside(struct journal *j, char *aside, size_t len) {
+    size_t plen = strlen(j->path) + 16;
+    char *old = malloc(plen);
+    int i, r = -1;
+    for (i = 1; i < 100 && r == -1; i++) {
+        if (i == 1) snprintf(old, plen, "%s.old", j->path);
+        else snprintf(old, plen, "%s.old.%d", j->path, i);
+        r = link(j->path, old);
+        if (r == -1 && errno != EEXIST) break;
+    }
+    if (r == -1) {
+        free(old);
+        return -1;
+    }
+    char *slash = strrchr(old, '/');
+    snprintf(aside, len, "%s", slash ? slash + 1 : old);
+    free(old);
+
+    // our lock is on the old inode, so the new one is made and locked
+    // before letting go of it
+    unlink(j->path);
+    int fd = open(j->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd == -1 || flock(fd, LOCK_EX | LOCK_NB) == -1) {
+        if (fd != -1) close(fd);
+        return -1;
+    }
+    close(j->fd);
+    j->fd = fd;
+    return jnDiscard(j);
+}
+
+void jnClose(struct journal *j, int remove) {
+    if (j->fd != -1) {
+        if (remove) unlink(j->path);
+        close(j->fd);
+    }
+    free(j->path);
+    abFree(&j->buf);
+    jnInit(j);
+}
+
+/*** replay ***/
+static int jnNumber(const char *d, size_t len, size_t *p,
+        unsigned long long *v) {
+    int shift = 0;
+    *v = 0;
+    while (*p < len && shift < 64) {
+        unsigned char b = d[(*p)++];
+        *v |= (unsigned long long)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return 0;
+        shift += 7;
+    }
+    return -1;
+}
+
+// the record at *p, moving *p past it, -1 if it runs off the end
+static int jnParse(const char *d, size_t len, size_t *p, struct jnRec *r) {
+    if (*p >= len) return -1;
+    r->type = d[(*p)++];
+    switch (r->type) {
+        case 'i':
+            if (jnNumber(d, len, p, &r->a) || jnNumber(d, len, p, &r->b)
+                    || jnNumber(d, len, p, &r->c) || r->c > len - *p)
+                return -1;
+            r->text = &d[*p];
+            r->len = r->c;
+            *p += r->c;
+            return 0;
+        case 'd':
+            return jnNumber(d, len, p, &r->a) || jnNumber(d, len, p, &r->b)
+                || jnNumber(d, len, p, &r->c) ? -1 : 0;
+        case 'a': {
+            if (jnNumber(d, len, p, &r->a) || jnNumber(d, len, p, &r->b))
+                return -1;
+            r->text = &d[*p];
+            unsigned long long i, size;
+            for (i = 0; i < r->b; i++) {
+                if (jnNumber(d, len, p, &size) || size > len - *p) return -1;
+                *p += size;
+            }
+            r->len = &d[*p] - r->text;
+            return 0;
+        }
+        case 'r':
+            return jnNumber(d, len, p, &r->a) || jnNumber(d, len, p, &r->b)
+                ? -1 : 0;
+        case 'c':
+            return jnNumber(d, len, p, &r->a) || jnNumber(d, len, p, &r->b)
+                || jnNumber(d, len, p, &r->c) || jnNumber(d, len, p, &r->d)
+                ? -1 : 0;
+    }
+    return -1;
+}
+
+// whether r can be applied to a buffer of *rows rows, and the rows after
+static int jnFits(struct jnRec *r, unsigned long long *rows) {
+    switch (r->type) {
+        case 'i':
+        case 'd':
+            return r->a < *rows ? 0 : -1;
+        case 'a':
+            if (r->a > *rows || r->b == 0 || r->b > INT_MAX - *rows) return -1;
+            *rows += r->b;
+            return 0;
+        case 'r':
+            if (r->b > *rows || r->a > *rows - r->b) return -1;
+            *rows -= r->b;
+            return 0;
+    }
+    return -1;
+}
+
+// apply a record jnFits passed
+static void jnApply(struct editorConfig *E, struct jnRec *r) {
+    switch (r->type) {
+        case 'i':
+            eRowInsert(r->a, r->b, r->text, r->len, E);
+            break;
+        case 'd':
+            eRowDelete(r->a, r->b, r->c, E);
+            break;
+        case 'a': {
+            erow *rows = malloc(sizeof(erow) * r->b);
+            size_t p = 0;
+            unsigned long long i, size;
+            for (i = 0; i < r->b; i++) {
+                jnNumber(r->text, r->len, &p, &size);
+                erow *row = &rows[i];
+                row->size = size;
+                row->chars = arAlloc(&E->arena, size + 1, &row->cap);
+                memcpy(row->chars, &r->text[p], size);
+                row->chars[size] = '\0';
+                p += size;
+            }
+            ePutRows(r->a, rows, r->b, E);
+            free(rows);
+            unRows(E, UN_ADDROWS, r->a, NULL, r->b);
+            break;
+        }
+        case 'r':
+            eDelRows(r->a, r->b, E);
+            break;
+    }
+}
+
+// play the journal over the file just opened, as one undo step, a segment
+// of records at a time and only while each checks out against its
+// checkpoint. Anything after the last good one is cut off the journal.
+// Returns the number of changes made.
+int jnReplay(struct journal *j, struct editorConfig *E) {
+    size_t len = j->size;
+    char *d = malloc(len);
+    if (d == NULL || pread(j->fd, d, len, 0) != (ssize_t)len) {
+        free(d);
+        return 0;
+    }
+
+    size_t p = JN_HEADER, good = JN_HEADER;
+    int changes = 0;
+    struct jnRec r;
+    unStep(&E->undo);
+    j->replaying = 1;
+    while (p < len) {
+        // find the checkpoint closing the segment and check its hash
+        size_t q = p, end = p;
+        int closed = 0;
+        while (jnParse(d, len, &q, &r) == 0) {
+            if (r.type == 'c') {
+                closed = 1;
+                break;
+            }
+            end = q;
+        }
+        if (!closed || jnHash(JN_FNV, &d[p], end - p) != r.d) break;
+        struct jnRec cp = r;
+
+        // every record in the segment is checked before any is applied,
+        // so a bad one can't leave half a segment in the buffer
+        unsigned long long rows = E->numrows;
+        size_t at = p;
+        int bad = 0;
+        while (at < end && !bad) {
+            jnParse(d, len, &at, &r);
+            bad = jnFits(&r, &rows) == -1;
+        }
+        if (bad || rows != cp.a) break;
+
+        while (p < end) {
+            jnParse(d, len, &p, &r);
+            jnApply(E, &r);
+            changes++;
+        }
+        E->cx = cp.b;
+        E->cy = cp.c;
+        p = good = q;
+    }
+    j->replaying = 0;
+    free(d);
+
+    // the cursor where it was, as far as the rows allow
+    if (E->cy >= E->numrows) E->cy = E->numrows ? E->numrows - 1 : 0;
+    erow *row = rsGet(&E->rows, E->cy);
+    if (row == NULL || E->cx > row->size) E->cx = row ? row->size : 0;
+
+    j->size = good;
+    if (ftruncate(j->fd, good) == -1) j->err = errno;
+    return changes;
+}
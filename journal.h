@@ -0,0 +1,67 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "buffer.h"
+#include "erow.h"
+
+/*** JOURNAL ***/
+// Every change row.c makes is appended to a journal next to the file
+// (.name.envyj), so what a crash loses is never more than the last frame's
+// keys however big the file is, and keeping it costs about as much as the
+// edits themselves. Records are a type byte and varints:
+//
+//   'i' row col len text   text put in       'a' at n (len text)*n  rows put in
+//   'd' row col n          text taken out    'r' at n               rows taken out
+//   'c' numrows cx cy hash checkpoint
+//
+// They are buffered and written out each frame with a checkpoint after
+// them, holding the FNV-1a hash of the records since the last one so a torn
+// write is never replayed. fdatasync follows at most every
+// ENVY_JOURNAL_SYNC ms. The header names the size, mtime and inode of the
+// file the records apply to. A save makes a new header for the file as
+// written and keeps only the records made since the save started.
+#define JN_MAGIC "ENVYJ001"
+#define JN_HEADER 40  // magic, then size, mtime s, mtime ns, inode
+#define JN_BUF (1 << 20) // records buffered before going out mid-frame
+
+enum jnState {
+    JN_NONE,  // no journal with anything in it
+    JN_FOUND, // one for this version of the file, see jnReplay
+    JN_STALE, // one for a version of the file that has since changed
+    JN_BUSY   // one another envy is writing to, not journaling
+};
+
+struct editorConfig;
+
+struct journal {
+    int on;          // journal files opened by eOpen
+    int fd;          // -1 while not journaling
+    char *path;
+    unsigned char id[JN_HEADER - 8]; // the file as the records start from
+    struct abuf buf; // records not yet written
+    unsigned hash;   // of the records since the last checkpoint
+    off_t size;      // bytes in the file, buf aside
+    off_t mark;      // size when the running save started
+    int pending;     // records since the last checkpoint
+    int unsynced;    // written since the last fdatasync
+    long long synced;
+    int err;         // errno of a write that failed, 0 if none has
+    int replaying;
+};
+
+void jnInit(struct journal *j);
+int jnOpen(struct journal *j, const char *filename);
+int jnReplay(struct journal *j, struct editorConfig *E);
+int jnDiscard(struct journal *j);
+int jnSetAside(struct journal *j, char *aside, size_t len);
+void jnInsert(struct journal *j, int row, int col, const char *s, int len);
+void jnDelete(struct journal *j, int row, int col, int n);
+void jnAddRows(struct journal *j, int at, const erow *rows, int n);
+void jnDelRows(struct journal *j, int at, int n);
+int jnFlush(struct journal *j, int numrows, int cx, int cy);
+int jnRebase(struct journal *j, const char *filename);
+void jnClose(struct journal *j, int remove);
+#endif
@@ -0,0 +1,148 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "latency.h"
+
+static const char *latNames[LAT_STEPS] = {
+    "wait", "dispatch", "compose", "write", "total", "frame_bytes"
+};
+
+void latInit(struct latency *l) {
+    l->on = 0;
+    l->show = 0;
+    l->arrived = l->keyat = 0;
+    l->hist = NULL;
+}
+
+// start recording, if it wasn't already
+void latStart(struct latency *l) {
+    if (l->on) return;
+    l->hist = calloc(LAT_STEPS, sizeof(struct latHist));
+    l->on = l->hist != NULL;
+}
+
+void latFree(struct latency *l) {
+    free(l->hist);
+    latInit(l);
+}
+
+long long latNow() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// values under LAT_SUB get a bucket each, above that the top five bits
+// (the leading one and four more) pick the bucket
+static int latBucket(unsigned long long v) {
+    if (v < LAT_SUB) return v;
+    int e = 63 - __builtin_clzll(v);
+    return (e - 3) * LAT_SUB + (int)((v >> (e - 4)) & (LAT_SUB - 1));
+}
+
+// the highest value that lands in bucket i
+static unsigned long long latTop(int i) {
+    if (i < LAT_SUB) return i;
+    int e = i / LAT_SUB + 3;
+    unsigned long long lo = (unsigned long long)(LAT_SUB + i % LAT_SUB) << (e - 4);
+    return lo + ((1ULL << (e - 4)) - 1);
+}
+
+void latRecord(struct latency *l, int step, long long v) {
+    struct latHist *h = &l->hist[step];
+    if (v < 0) v = 0;
+    h->count[latBucket(v)]++;
+    if (h->n == 0 || (unsigned long long)v < h->min) h->min = v;
+    if ((unsigned long long)v > h->max) h->max = v;
+    h->n++;
+    h->sum += v;
+}
+
+// eReadKey has input for a frame that hasn't been drawn yet
+void latArrived(struct latency *l) {
+    if (l->arrived == 0) l->arrived = latNow();
+}
+
+// and is handing a key out
+void latKey(struct latency *l) {
+    long long now = latNow();
+    if (l->arrived) latRecord(l, LAT_WAIT, now - l->arrived);
+    l->keyat = now;
+}
+
+// the key has been dealt with, eReadKey wants another or a frame is due
+void latDispatched(struct latency *l) {
+    if (l->keyat == 0) return;
+    latRecord(l, LAT_DISPATCH, latNow() - l->keyat);
+    l->keyat = 0;
+}
+
+// a frame of bytes has been written, drawing it started at start and the
+// write at composed
+void latFrame(struct latency *l, long long start, long long composed, int bytes) {
+    long long now = latNow();
+    latRecord(l, LAT_COMPOSE, composed - start);
+    latRecord(l, LAT_WRITE, now - composed);
+    latRecord(l, LAT_BYTES, bytes);
+    if (l->arrived) latRecord(l, LAT_TOTAL, now - l->arrived);
+    l->arrived = 0;
+}
+
+// the value p (0-100) percent of recorded values are at or below, to within
+// a bucket
+long long latPercentile(struct latHist *h, double p) {
+    if (h->n == 0) return 0;
+    unsigned long long want = (unsigned long long)(h->n * p / 100.0 + 0.5);
+    unsigned long long seen = 0;
+    int i;
+    if (want < 1) want = 1;
+    for (i = 0; i < LAT_BUCKETS; i++) {
+        seen += h->count[i];
+        if (seen >= want) return latTop(i) < h->max ? latTop(i) : h->max;
+    }
+    return h->max;
+}
+
+// 850us, 1.2ms, 14ms
+void latFormat(char *buf, int size, long long ns) {
+    if (ns < 1000000)
+        snprintf(buf, size, "%lldus", ns / 1000);
+    else if (ns < 10000000)
+        snprintf(buf, size, "%.1fms", ns / 1e6);
+    else
+        snprintf(buf, size, "%lldms", ns / 1000000);
+}
+
+// a summary line per step and then every bucket in use, as plain text
+int latDump(struct latency *l, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return -1;
+
+    static const double pcts[] = { 50, 90, 99, 99.9 };
+    int s, i;
+    fprintf(fp, "# envy latency, ns (frame_bytes in bytes)\n"
+            "# step count min p50 p90 p99 p99.9 max mean\n");
+    for (s = 0; s < LAT_STEPS; s++) {
+        struct latHist *h = l->on ? &l->hist[s] : NULL;
+        fprintf(fp, "%s %llu", latNames[s], h ? h->n : 0);
+        if (h == NULL || h->n == 0) {
+            fprintf(fp, "\n");
+            continue;
+        }
+        fprintf(fp, " %llu", h->min);
+        for (i = 0; i < (int)(sizeof(pcts) / sizeof(pcts[0])); i++)
+            fprintf(fp, " %lld", latPercentile(h, pcts[i]));
+        fprintf(fp, " %llu %llu\n", h->max, h->sum / h->n);
+    }
+
+    fprintf(fp, "# step bucket_max count\n");
+    for (s = 0; l->on && s < LAT_STEPS; s++)
+        for (i = 0; i < LAT_BUCKETS; i++)
+            if (l->hist[s].count[i])
+                fprintf(fp, "%s %llu %llu\n", latNames[s], latTop(i),
+                        l->hist[s].count[i]);
+    return fclose(fp);
+}
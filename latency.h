@@ -0,0 +1,50 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+/*** LATENCY ***/
+// Timings of each step from a key arriving to the frame that shows it
+// reaching the terminal, kept as HDR style histograms: buckets double in
+// width every LAT_SUB of them, so any value from a nanosecond up is held to
+// within about 6% in under a thousand counters and percentiles come
+// straight out of the counts. Off until ENVY_LATENCY names a file to dump
+// them to on exit or CTRL-T asks for p50/p99 in the status bar, and while
+// off each step costs one test of lat.on.
+#define LAT_SUB 16
+#define LAT_BUCKETS ((64 - 3) * LAT_SUB)
+
+enum latStep {
+    LAT_WAIT,     // key arriving to eReadKey handing it out
+    LAT_DISPATCH, // acting on the key
+    LAT_COMPOSE,  // drawing the frame into the screen grid
+    LAT_WRITE,    // the write() of the frame
+    LAT_TOTAL,    // first key after a frame arriving to the next frame out
+    LAT_BYTES,    // bytes per frame, not a time
+    LAT_STEPS
+};
+
+struct latHist {
+    unsigned long long count[LAT_BUCKETS];
+    unsigned long long n, sum, min, max;
+};
+
+struct latency {
+    int on;
+    int show;          // p50/p99 in the status bar
+    long long arrived; // first key not on screen yet arrived at, 0 for none
+    long long keyat;   // key being acted on since, 0 for none
+    struct latHist *hist; // LAT_STEPS of them, allocated by latStart
+};
+
+void latInit(struct latency *l);
+void latStart(struct latency *l);
+void latFree(struct latency *l);
+long long latNow();
+void latRecord(struct latency *l, int step, long long v);
+void latArrived(struct latency *l);
+void latKey(struct latency *l);
+void latDispatched(struct latency *l);
+void latFrame(struct latency *l, long long start, long long composed, int bytes);
+long long latPercentile(struct latHist *h, double p);
+void latFormat(char *buf, int size, long long ns);
+int latDump(struct latency *l, const char *path);
+#endif
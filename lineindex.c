@@ -0,0 +1,177 @@
+#define _DEFAULT_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "lineindex.h"
+
+struct liChunk {
+    const char *base;
+    size_t start, end;
+    size_t *off;
+    size_t n, cap;
+    int every; // for liBlocks, lines per block
+    int lines; // lines seen since the last block ended
+};
+
+static void liPush(struct liChunk *c, size_t off) {
+    if (c->n == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 4096;
+        c->off = realloc(c->off, sizeof(size_t) * c->cap);
+    }
+    c->off[c->n++] = off;
+}
+
+// a newline at off, liScan keeps them all and liBlocks only the ones that
+// end a block
+static void liNewline(struct liChunk *c, size_t off) {
+    if (c->every == 0) {
+        liPush(c, off);
+    } else if (++c->lines == c->every) {
+        liPush(c, off + 1);
+        c->lines = 0;
+    }
+}
+
+// record the offset of every '\n' in [start, end), 16 bytes at a time
+static void *liScanChunk(void *arg) {
+    struct liChunk *c = arg;
+    const char *buf = c->base;
+    size_t i = c->start;
+
+#ifdef __SSE2__
+    const __m128i nl = _mm_set1_epi8('\n');
+    for (; i + 16 <= c->end; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(buf + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+        while (mask) {
+            liNewline(c, i + __builtin_ctz(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while (i < c->end) {
+        const char *p = memchr(buf + i, '\n', c->end - i);
+        if (p == NULL) break;
+        liNewline(c, p - buf);
+        i = p - buf + 1;
+    }
+    return NULL;
+}
+
+// run liScanChunk over buf split between up to LI_MAX_THREADS threads,
+// returns how many chunks it was split into
+static int liRun(struct liChunk *chunk, const char *buf, size_t len,
+        int every) {
+    pthread_t tid[LI_MAX_THREADS];
+    int started[LI_MAX_THREADS];
+    int nthreads = 1;
+
+    if (len >= LI_THREAD_MIN) {
+        long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+        if (ncpu > 1) nthreads = ncpu > LI_MAX_THREADS ? LI_MAX_THREADS : ncpu;
+    }
+
+    int t;
+    for (t = 0; t < nthreads; t++) {
+        chunk[t].base = buf;
+        chunk[t].start = len / nthreads * t;
+        chunk[t].off = NULL;
+        chunk[t].n = chunk[t].cap = 0;
+        chunk[t].every = every;
+        chunk[t].lines = 0;
+        // blocks have to end on a line, so the chunks start on one
+        if (every && t > 0) {
+            const char *p = memchr(buf + chunk[t].start, '\n',
+                    len - chunk[t].start);
+            chunk[t].start = p ? (size_t)(p - buf) + 1 : len;
+            if (chunk[t].start < chunk[t - 1].start)
+                chunk[t].start = chunk[t - 1].start;
+        }
+    }
+    for (t = 0; t < nthreads; t++)
+        chunk[t].end = (t == nthreads - 1) ? len : chunk[t + 1].start;
+
+    // the first chunk runs here, so a single chunk never spawns a thread
+    for (t = 1; t < nthreads; t++) {
+        started[t] = pthread_create(&tid[t], NULL, liScanChunk, &chunk[t]) == 0;
+        if (!started[t]) liScanChunk(&chunk[t]);
+    }
+    liScanChunk(&chunk[0]);
+    for (t = 1; t < nthreads; t++)
+        if (started[t]) pthread_join(tid[t], NULL);
+    return nthreads;
+}
+
+// returns a malloc'd array of the offsets of every newline in buf
+size_t *liScan(const char *buf, size_t len, size_t *count) {
+    struct liChunk chunk[LI_MAX_THREADS];
+    int nthreads = liRun(chunk, buf, len, 0);
+    int t;
+
+    size_t total = 0;
+    for (t = 0; t < nthreads; t++)
+        total += chunk[t].n;
+
+    // stitch the per chunk results together, reusing the first chunk's
+    // array when it already holds everything
+    size_t *off = chunk[0].off;
+    if (nthreads > 1) {
+        off = malloc(sizeof(size_t) * (total ? total : 1));
+        size_t n = 0;
+        for (t = 0; t < nthreads; t++) {
+            memcpy(&off[n], chunk[t].off, sizeof(size_t) * chunk[t].n);
+            n += chunk[t].n;
+            free(chunk[t].off);
+        }
+    }
+
+    *count = total;
+    return off;
+}
+
+// cut buf into blocks of at most every lines, without holding on to where
+// each line starts, returns a malloc'd array of them
+struct liBlock *liBlocks(const char *buf, size_t len, int every,
+        size_t *count) {
+    struct liChunk chunk[LI_MAX_THREADS];
+    int nthreads = liRun(chunk, buf, len, every);
+    int t;
+
+    size_t total = 0;
+    for (t = 0; t < nthreads; t++)
+        total += chunk[t].n + 1;
+
+    struct liBlock *b = malloc(sizeof(struct liBlock) * total);
+    size_t n = 0;
+    for (t = 0; t < nthreads; t++) {
+        struct liChunk *c = &chunk[t];
+        size_t start = c->start;
+        size_t i;
+        for (i = 0; i < c->n; i++) {
+            b[n].off = start;
+            b[n].len = c->off[i] - start;
+            b[n].lines = every;
+            start = c->off[i];
+            n++;
+        }
+        // whatever is left over up to the next chunk, plus the last line
+        // of the file when it has no newline
+        if (start < c->end) {
+            b[n].off = start;
+            b[n].len = c->end - start;
+            b[n].lines = c->lines + (buf[c->end - 1] != '\n');
+            n++;
+        }
+        free(c->off);
+    }
+
+    *count = n;
+    return b;
+}
@@ -0,0 +1,21 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <stddef.h>
+
+/*** LINE INDEX ***/
+// Files smaller than this are scanned on the calling thread, anything bigger
+// is split between one scanner per online cpu (up to LI_MAX_THREADS).
+#define LI_THREAD_MIN (1 << 20)
+#define LI_MAX_THREADS 16
+
+// a run of whole lines, see liBlocks
+struct liBlock {
+    size_t off, len;
+    int lines;
+};
+
+size_t *liScan(const char *buf, size_t len, size_t *count);
+struct liBlock *liBlocks(const char *buf, size_t len, int every,
+        size_t *count);
+#endif
@@ -0,0 +1,740 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "regex.h"
+
+/*** parser ***/
+enum { RN_SET, RN_CAT, RN_ALT, RN_STAR, RN_PLUS, RN_QUEST, RN_BOL, RN_EOL,
+    RN_EMPTY };
+
+struct reNode {
+    int type;
+    int set;    // RN_SET: index into the set table
+    int l, r;   // children, -1 for none
+};
+
+struct reSet {
+    unsigned char bits[32];
+};
+
+struct reParser {
+    const char *p;
+    struct reNode *node;
+    int nnode, capnode;
+    struct reSet *set;
+    int nset, capset;
+    int err;
+};
+
+static void *reGrow(void *p, int *cap, int need, size_t size) {
+    if (need <= *cap) return p;
+    int ncap = *cap ? *cap * 2 : 16;
+    while (ncap < need) ncap *= 2;
+    void *n = realloc(p, size * ncap);
+    if (n == NULL) return NULL;
+    *cap = ncap;
+    return n;
+}
+
+static int reNewNode(struct reParser *ps, int type, int l, int r) {
+    struct reNode *n = reGrow(ps->node, &ps->capnode, ps->nnode + 1,
+            sizeof(struct reNode));
+    if (n == NULL) {
+        ps->err = 1;
+        return -1;
+    }
+    ps->node = n;
+    n[ps->nnode].type = type;
+    n[ps->nnode].set = -1;
+    n[ps->nnode].l = l;
+    n[ps->nnode].r = r;
+    return ps->nnode++;
+}
+
+static int reNewSet(struct reParser *ps) {
+    struct reSet *s = reGrow(ps->set, &ps->capset, ps->nset + 1,
+            sizeof(struct reSet));
+    if (s == NULL) {
+        ps->err = 1;
+        return -1;
+    }
+    ps->set = s;
+    memset(&s[ps->nset], 0, sizeof(struct reSet));
+    return ps->nset++;
+}
+
+#define RE_SETBIT(s, c) ((s)->bits[(unsigned char)(c) >> 3] |= 1 << ((c) & 7))
+#define RE_HASBIT(s, c) ((s)->bits[(unsigned char)(c) >> 3] & (1 << ((c) & 7)))
+
+static void reSetRange(struct reSet *s, int lo, int hi) {
+    int c;
+    for (c = lo; c <= hi; c++) RE_SETBIT(s, c);
+}
+
+static void reSetInvert(struct reSet *s) {
+    int i;
+    for (i = 0; i < 32; i++) s->bits[i] = ~s->bits[i];
+}
+
+// \d \w \s and their negations, returns 0 if c isn't a class letter
+static int reSetClass(struct reSet *s, int c) {
+    struct reSet t;
+    memset(&t, 0, sizeof(t));
+    switch (c | 0x20) {
+        case 'd':
+            reSetRange(&t, '0', '9');
+            break;
+        case 'w':
+            reSetRange(&t, '0', '9');
+            reSetRange(&t, 'a', 'z');
+            reSetRange(&t, 'A', 'Z');
+            RE_SETBIT(&t, '_');
+            break;
+        case 's':
+            reSetRange(&t, '\t', '\r');
+            RE_SETBIT(&t, ' ');
+            break;
+        default:
+            return 0;
+    }
+    if (c >= 'A' && c <= 'Z') reSetInvert(&t);
+
+    int i;
+    for (i = 0; i < 32; i++) s->bits[i] |= t.bits[i];
+    return 1;
+}
+
+static int reEscape(int c) {
+    switch (c) {
+        case 't': return '\t';
+        case 'n': return '\n';
+        case 'r': return '\r';
+        default: return c;
+    }
+}
+
+static int reParseAlt(struct reParser *ps);
+
+static int reParseClass(struct reParser *ps) {
+    int s = reNewSet(ps);
+    if (s < 0) return -1;
+    struct reSet *set = &ps->set[s];
+
+    int negate = 0;
+    if (*ps->p == '^') {
+        negate = 1;
+        ps->p++;
+    }
+
+    int first = 1;
+    while (*ps->p && (*ps->p != ']' || first)) {
+        int lo = (unsigned char)*ps->p++;
+        first = 0;
+        if (lo == '\\' && *ps->p) {
+            lo = (unsigned char)*ps->p++;
+            if (reSetClass(set, lo)) continue;
+            lo = reEscape(lo);
+        }
+
+        int hi = lo;
+        if (ps->p[0] == '-' && ps->p[1] && ps->p[1] != ']') {
+            ps->p++;
+            hi = (unsigned char)*ps->p++;
+            if (hi == '\\' && *ps->p) hi = reEscape((unsigned char)*ps->p++);
+            if (hi < lo) {
+                ps->err = 1;
+                return -1;
+            }
+        }
+        reSetRange(set, lo, hi);
+    }
+
+    if (*ps->p != ']') {
+        ps->err = 1;
+        return -1;
+    }
+    ps->p++;
+
+    if (negate) reSetInvert(set);
+    int n = reNewNode(ps, RN_SET, -1, -1);
+    if (n >= 0) ps->node[n].set = s;
+    return n;
+}
+
+static int reParseAtom(struct reParser *ps) {
+    int c = (unsigned char)*ps->p;
+    int n, s;
+
+    switch (c) {
+        case '(':
+            ps->p++;
+            n = reParseAlt(ps);
+            if (*ps->p != ')') {
+                ps->err = 1;
+                return -1;
+            }
+            ps->p++;
+            return n;
+        case '[':
+            ps->p++;
+            return reParseClass(ps);
+        case '^':
+            ps->p++;
+            return reNewNode(ps, RN_BOL, -1, -1);
+        case '$':
+            ps->p++;
+            return reNewNode(ps, RN_EOL, -1, -1);
+        case '*': case '+': case '?':
+            ps->err = 1; // nothing to repeat
+            return -1;
+    }
+
+    s = reNewSet(ps);
+    if (s < 0) return -1;
+    ps->p++;
+    if (c == '.') {
+        reSetRange(&ps->set[s], 0, '\n' - 1);
+        reSetRange(&ps->set[s], '\n' + 1, 255);
+    } else if (c == '\\') {
+        c = (unsigned char)*ps->p;
+        if (c == '\0') {
+            ps->err = 1;
+            return -1;
+        }
+        ps->p++;
+        if (!reSetClass(&ps->set[s], c))
+            RE_SETBIT(&ps->set[s], reEscape(c));
+    } else {
+        RE_SETBIT(&ps->set[s], c);
+    }
+
+    n = reNewNode(ps, RN_SET, -1, -1);
+    if (n >= 0) ps->node[n].set = s;
+    return n;
+}
+
+static int reParseRepeat(struct reParser *ps) {
+    int n = reParseAtom(ps);
+    while (n >= 0) {
+        int type;
+        switch (*ps->p) {
+            case '*': type = RN_STAR; break;
+            case '+': type = RN_PLUS; break;
+            case '?': type = RN_QUEST; break;
+            default: return n;
+        }
+        ps->p++;
+        n = reNewNode(ps, type, n, -1);
+    }
+    return n;
+}
+
+static int reParseCat(struct reParser *ps) {
+    int n = -1;
+    while (*ps->p && *ps->p != '|' && *ps->p != ')' && !ps->err) {
+        int m = reParseRepeat(ps);
+        if (m < 0) return -1;
+        n = n < 0 ? m : reNewNode(ps, RN_CAT, n, m);
+    }
+    return n < 0 ? reNewNode(ps, RN_EMPTY, -1, -1) : n;
+}
+
+static int reParseAlt(struct reParser *ps) {
+    int n = reParseCat(ps);
+    while (n >= 0 && *ps->p == '|') {
+        ps->p++;
+        int m = reParseCat(ps);
+        if (m < 0) return -1;
+        n = reNewNode(ps, RN_ALT, n, m);
+    }
+    return n;
+}
+
+/*** compiler ***/
+enum { RI_SET, RI_SPLIT, RI_JMP, RI_BOL, RI_EOL, RI_MATCH };
+
+struct reInst {
+    int op;
+    int x, y;   // RI_SPLIT prefers x, RI_JMP goes to x, RI_SET uses set x
+};
+
+struct reProg {
+    struct reInst *inst;
+    int n, cap;
+    struct reSet *set;
+    int nset;
+};
+
+static int reEmit(struct reProg *pg, int op, int x, int y) {
+    struct reInst *in = reGrow(pg->inst, &pg->cap, pg->n + 1,
+            sizeof(struct reInst));
+    if (in == NULL) return -1;
+    pg->inst = in;
+    in[pg->n].op = op;
+    in[pg->n].x = x;
+    in[pg->n].y = y;
+    return pg->n++;
+}
+
+// emit node n, concatenations backwards when building the reverse program
+static int reGen(struct reProg *pg, struct reNode *node, int n, int rev) {
+    struct reNode *nd = &node[n];
+    int a, b;
+
+    switch (nd->type) {
+        case RN_SET:
+            return reEmit(pg, RI_SET, nd->set, 0) < 0 ? -1 : 0;
+        case RN_BOL:
+            return reEmit(pg, rev ? RI_EOL : RI_BOL, 0, 0) < 0 ? -1 : 0;
+        case RN_EOL:
+            return reEmit(pg, rev ? RI_BOL : RI_EOL, 0, 0) < 0 ? -1 : 0;
+        case RN_EMPTY:
+            return 0;
+        case RN_CAT:
+            if (reGen(pg, node, rev ? nd->r : nd->l, rev) < 0) return -1;
+            return reGen(pg, node, rev ? nd->l : nd->r, rev);
+        case RN_ALT:
+            if ((a = reEmit(pg, RI_SPLIT, 0, 0)) < 0) return -1;
+            pg->inst[a].x = pg->n;
+            if (reGen(pg, node, nd->l, rev) < 0) return -1;
+            if ((b = reEmit(pg, RI_JMP, 0, 0)) < 0) return -1;
+            pg->inst[a].y = pg->n;
+            if (reGen(pg, node, nd->r, rev) < 0) return -1;
+            pg->inst[b].x = pg->n;
+            return 0;
+        case RN_STAR:
+            if ((a = reEmit(pg, RI_SPLIT, 0, 0)) < 0) return -1;
+            pg->inst[a].x = pg->n;
+            if (reGen(pg, node, nd->l, rev) < 0) return -1;
+            if (reEmit(pg, RI_JMP, a, 0) < 0) return -1;
+            pg->inst[a].y = pg->n;
+            return 0;
+        case RN_PLUS:
+            a = pg->n;
+            if (reGen(pg, node, nd->l, rev) < 0) return -1;
+            return reEmit(pg, RI_SPLIT, a, pg->n + 1) < 0 ? -1 : 0;
+        case RN_QUEST:
+            if ((a = reEmit(pg, RI_SPLIT, 0, 0)) < 0) return -1;
+            pg->inst[a].x = pg->n;
+            if (reGen(pg, node, nd->l, rev) < 0) return -1;
+            pg->inst[a].y = pg->n;
+            return 0;
+    }
+    return -1;
+}
+
+static void reFreeProg(struct reProg *pg) {
+    if (pg == NULL) return;
+    free(pg->inst);
+    free(pg->set);
+    free(pg);
+}
+
+static struct reProg *reBuild(struct reParser *ps, int root, int rev) {
+    struct reProg *pg = calloc(1, sizeof(struct reProg));
+    if (pg == NULL) return NULL;
+
+    if (reGen(pg, ps->node, root, rev) < 0
+            || reEmit(pg, RI_MATCH, 0, 0) < 0
+            || (pg->set = malloc(sizeof(struct reSet) * (ps->nset + 1))) == NULL) {
+        reFreeProg(pg);
+        return NULL;
+    }
+    memcpy(pg->set, ps->set, sizeof(struct reSet) * ps->nset);
+    pg->nset = ps->nset;
+    return pg;
+}
+
+// collect the run of single characters every match has to start with
+static int rePrefix(struct reParser *ps, int n, char *buf, int *len) {
+    struct reNode *nd = &ps->node[n];
+
+    if (nd->type == RN_CAT)
+        return rePrefix(ps, nd->l, buf, len) && rePrefix(ps, nd->r, buf, len);
+    if (nd->type != RN_SET) return 0;
+
+    struct reSet *s = &ps->set[nd->set];
+    int c, only = -1;
+    for (c = 0; c < 256; c++) {
+        if (!RE_HASBIT(s, c)) continue;
+        if (only >= 0) return 0;
+        only = c;
+    }
+    if (only < 0) return 0;
+    buf[(*len)++] = only;
+    return 1;
+}
+
+/*** lazy DFA ***/
+// A DFA state is the ordered list of NFA threads alive at some point in the
+// text. Keeping them in priority order gives leftmost-first (perl style)
+// semantics on the forward pass: once a thread matches, everything behind
+// it, including threads that would start further right, is dropped. The
+// reverse pass runs anchored and keeps the longest match instead.
+#define RD_MATCH   1 // a match ends here
+#define RD_NOSTART 2 // a match was seen, don't start new threads
+
+struct reState {
+    struct reState *next[256];
+    struct reState *chain;   // hash bucket
+    unsigned hash;
+    int flags;
+    int endmatch;            // -1 not computed yet
+    int n;
+    int pc[];
+};
+
+struct reDFA {
+    struct reProg *pg;
+    int first;               // leftmost-first and unanchored, else longest
+    struct reState **table;
+    int nbucket;
+    int nstate;
+    struct reState *start[2]; // indexed by "at the start of the row"
+    int *list, nlist;        // scratch for building a state
+    unsigned flushes;
+    unsigned *seen, gen;
+    int matched;
+};
+
+static struct reDFA *reNewDFA(struct reProg *pg, int first) {
+    struct reDFA *d = calloc(1, sizeof(struct reDFA));
+    if (d == NULL) return NULL;
+    d->pg = pg;
+    d->first = first;
+    d->nbucket = RE_MAX_STATES * 2;
+    d->table = calloc(d->nbucket, sizeof(struct reState *));
+    d->list = malloc(sizeof(int) * pg->n);
+    d->seen = calloc(pg->n, sizeof(unsigned));
+    if (d->table == NULL || d->list == NULL || d->seen == NULL) {
+        free(d->table);
+        free(d->list);
+        free(d->seen);
+        free(d);
+        return NULL;
+    }
+    return d;
+}
+
+static void reFlush(struct reDFA *d) {
+    int i;
+    for (i = 0; i < d->nbucket; i++) {
+        struct reState *s = d->table[i];
+        while (s) {
+            struct reState *next = s->chain;
+            free(s);
+            s = next;
+        }
+        d->table[i] = NULL;
+    }
+    d->nstate = 0;
+    d->flushes++;
+    d->start[0] = d->start[1] = NULL;
+}
+
+static void reFreeDFA(struct reDFA *d) {
+    if (d == NULL) return;
+    reFlush(d);
+    free(d->table);
+    free(d->list);
+    free(d->seen);
+    free(d);
+}
+
+// follow pc through the epsilon transitions, appending the threads that are
+// waiting on a character (or on the end of the row) to the scratch list
+static void reAdd(struct reDFA *d, int pc, int bol, int eol) {
+    if (d->first && d->matched) return;
+    if (d->seen[pc] == d->gen) return;
+    d->seen[pc] = d->gen;
+
+    struct reInst *in = &d->pg->inst[pc];
+    switch (in->op) {
+        case RI_JMP:
+            reAdd(d, in->x, bol, eol);
+            break;
+        case RI_SPLIT:
+            reAdd(d, in->x, bol, eol);
+            reAdd(d, in->y, bol, eol);
+            break;
+        case RI_BOL:
+            if (bol) reAdd(d, pc + 1, bol, eol);
+            break;
+        case RI_EOL:
+            if (eol)
+                reAdd(d, pc + 1, bol, eol);
+            else
+                d->list[d->nlist++] = pc;
+            break;
+        case RI_SET:
+            d->list[d->nlist++] = pc;
+            break;
+        case RI_MATCH:
+            d->matched = 1;
+            break;
+    }
+}
+
+static void reBegin(struct reDFA *d) {
+    d->nlist = 0;
+    d->matched = 0;
+    if (++d->gen == 0) {
+        memset(d->seen, 0, sizeof(unsigned) * d->pg->n);
+        d->gen = 1;
+    }
+}
+
+// find or create the state for the scratch list
+static struct reState *reIntern(struct reDFA *d, int flags) {
+    unsigned h = 2166136261u ^ flags;
+    int i;
+    for (i = 0; i < d->nlist; i++)
+        h = (h ^ d->list[i]) * 16777619u;
+
+    struct reState *s;
+    for (s = d->table[h % d->nbucket]; s; s = s->chain) {
+        if (s->hash == h && s->flags == flags && s->n == d->nlist
+                && memcmp(s->pc, d->list, sizeof(int) * d->nlist) == 0)
+            return s;
+    }
+
+    if (d->nstate >= RE_MAX_STATES) reFlush(d);
+    s = malloc(sizeof(struct reState) + sizeof(int) * d->nlist);
+    if (s == NULL) return NULL;
+    memset(s->next, 0, sizeof(s->next));
+    s->hash = h;
+    s->flags = flags;
+    s->endmatch = -1;
+    s->n = d->nlist;
+    memcpy(s->pc, d->list, sizeof(int) * d->nlist);
+    s->chain = d->table[h % d->nbucket];
+    d->table[h % d->nbucket] = s;
+    d->nstate++;
+    return s;
+}
+
+static struct reState *reStart(struct reDFA *d, int bol) {
+    if (d->start[bol]) return d->start[bol];
+
+    reBegin(d);
+    reAdd(d, 0, bol, 0);
+    int flags = d->matched ? RD_MATCH | (d->first ? RD_NOSTART : 0) : 0;
+    struct reState *s = reIntern(d, flags);
+    d->start[bol] = s;
+    return s;
+}
+
+static struct reState *reStep(struct reDFA *d, struct reState *s, int c) {
+    if (s->next[c]) return s->next[c];
+
+    reBegin(d);
+    int i;
+    for (i = 0; i < s->n; i++) {
+        struct reInst *in = &d->pg->inst[s->pc[i]];
+        if (in->op == RI_SET && RE_HASBIT(&d->pg->set[in->x], c))
+            reAdd(d, s->pc[i] + 1, 0, 0);
+    }
+
+    int flags = s->flags & RD_NOSTART;
+    if (d->first && (s->flags & RD_MATCH)) flags |= RD_NOSTART;
+    if (d->first && !(flags & RD_NOSTART)) reAdd(d, 0, 0, 0);
+    if (d->matched) {
+        flags |= RD_MATCH;
+        if (d->first) flags |= RD_NOSTART;
+    }
+
+    // interning may flush the cache and with it s, so only link the
+    // transition if s is still there afterwards
+    unsigned flushes = d->flushes;
+    struct reState *next = reIntern(d, flags);
+    if (next && d->flushes == flushes)
+        s->next[c] = next;
+    return next;
+}
+
+// does a thread of s match if the row ends here
+static int reEndMatch(struct reDFA *d, struct reState *s, int bol) {
+    if (s->flags & RD_MATCH) return 1;
+    if (!bol && s->endmatch >= 0) return s->endmatch;
+
+    reBegin(d);
+    int i;
+    for (i = 0; i < s->n && !d->matched; i++) {
+        if (d->pg->inst[s->pc[i]].op == RI_EOL)
+            reAdd(d, s->pc[i] + 1, bol, 1);
+    }
+    if (!bol) s->endmatch = d->matched;
+    return d->matched;
+}
+
+/*** matching ***/
+// end of the leftmost-first match starting at or after from, or -1
+static int reForward(struct reDFA *d, const unsigned char *t, int len, int from) {
+    // with no threads left and none that could start, nothing can match
+    struct reState *s = reStart(d, 0);
+    if (s == NULL) return -1;
+    int idle = s->n == 0 && !(s->flags & RD_MATCH);
+    s = reStart(d, from == 0);
+    if (s == NULL) return -1;
+
+    int end = (s->flags & RD_MATCH) ? from : -1;
+    int i;
+    for (i = from; i < len; i++) {
+        s = reStep(d, s, t[i]);
+        if (s == NULL) return -1;
+        if (s->flags & RD_MATCH) end = i + 1;
+        if (s->n == 0 && ((s->flags & RD_NOSTART) || idle)) return end;
+    }
+    if (reEndMatch(d, s, len == 0)) end = len;
+    return end;
+}
+
+// start of the longest match ending at end and beginning no earlier than from
+static int reBackward(struct reDFA *d, const unsigned char *t, int len,
+        int from, int end) {
+    struct reState *s = reStart(d, end == len);
+    if (s == NULL) return end;
+
+    int start = (s->flags & RD_MATCH) ? end : -1;
+    int i;
+    for (i = end - 1; i >= from; i--) {
+        s = reStep(d, s, t[i]);
+        if (s == NULL) break;
+        if (s->flags & RD_MATCH) start = i;
+        if (s->n == 0) break;
+    }
+    // ^ in the pattern is $ to the reversed program
+    if (s && i < from && from == 0 && reEndMatch(d, s, len == 0))
+        start = 0;
+    return start < 0 ? end : start;
+}
+
+struct regex *reCompile(const char *pattern) {
+    struct reParser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.p = pattern;
+
+    struct regex *re = calloc(1, sizeof(struct regex));
+    if (re == NULL) return NULL;
+    re->owner = 1;
+
+    re->literal = strpbrk(pattern, ".[]()*+?|^$\\") == NULL;
+    re->lit = malloc(strlen(pattern) + 1);
+    if (re->lit == NULL) goto fail;
+    if (re->literal) {
+        strcpy(re->lit, pattern);
+        re->litlen = strlen(pattern);
+        return re;
+    }
+
+    int root = reParseAlt(&ps);
+    if (root < 0 || ps.err || *ps.p) goto fail;
+
+    rePrefix(&ps, root, re->lit, &re->litlen);
+    re->fwd = reBuild(&ps, root, 0);
+    re->rev = reBuild(&ps, root, 1);
+    if (re->fwd == NULL || re->rev == NULL) goto fail;
+    re->fdfa = reNewDFA(re->fwd, 1);
+    re->rdfa = reNewDFA(re->rev, 0);
+    if (re->fdfa == NULL || re->rdfa == NULL) goto fail;
+
+    free(ps.node);
+    free(ps.set);
+    return re;
+
+fail:
+    free(ps.node);
+    free(ps.set);
+    reFree(re);
+    return NULL;
+}
+
+// a second handle on the same compiled pattern with its own DFA caches
+struct regex *reClone(struct regex *re) {
+    struct regex *c = calloc(1, sizeof(struct regex));
+    if (c == NULL) return NULL;
+    *c = *re;
+    c->owner = 0;
+    c->fdfa = c->rdfa = NULL;
+    if (re->literal) return c;
+
+    c->fdfa = reNewDFA(re->fwd, 1);
+    c->rdfa = reNewDFA(re->rev, 0);
+    if (c->fdfa == NULL || c->rdfa == NULL) {
+        reFree(c);
+        return NULL;
+    }
+    return c;
+}
+
+void reFree(struct regex *re) {
+    if (re == NULL) return;
+    reFreeDFA(re->fdfa);
+    reFreeDFA(re->rdfa);
+    if (re->owner) {
+        reFreeProg(re->fwd);
+        reFreeProg(re->rev);
+        free(re->lit);
+    }
+    free(re);
+}
+
+// Substring search that compares the first and last byte of the needle
+// against 16 positions at a time and only looks closer where both agree,
+// which skips through text far quicker than memmem for the short needles
+// people type into a search prompt.
+static const char *reFind(const char *hay, int n, const char *needle, int m) {
+    if (m == 0) return hay;
+    if (m == 1) return memchr(hay, needle[0], n);
+
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[m - 1]);
+    for (; i + m - 1 + 16 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(hay + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+                    _mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            int j = i + __builtin_ctz(mask);
+            if (memcmp(hay + j + 1, needle + 1, m - 2) == 0) return hay + j;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    return memmem(hay + i, n - i, needle, m);
+}
+
+// find the leftmost match in text[from..len), 1 if there is one
+int reSearch(struct regex *re, const char *text, int len, int from,
+        int *start, int *end) {
+    if (from > len) return 0;
+
+    if (re->literal) {
+        const char *m = reFind(text + from, len - from, re->lit, re->litlen);
+        if (m == NULL) return 0;
+        *start = m - text;
+        *end = *start + re->litlen;
+        return 1;
+    }
+
+    // no match can start before the first copy of its literal prefix
+    if (re->litlen) {
+        const char *m = reFind(text + from, len - from, re->lit, re->litlen);
+        if (m == NULL) return 0;
+        from = m - text;
+    }
+
+    const unsigned char *t = (const unsigned char *)text;
+    int e = reForward(re->fdfa, t, len, from);
+    if (e < 0) return 0;
+    *start = reBackward(re->rdfa, t, len, from, e);
+    *end = e;
+    return 1;
+}
@@ -0,0 +1,33 @@
+#ifndef REGEX_H
+#define REGEX_H
+
+/*** REGEX ***/
+// Patterns are compiled to a Thompson NFA which is run as a DFA built
+// lazily from it, so matching is linear in the length of the text whatever
+// the pattern. A forward pass finds where the leftmost match ends and a
+// pass of the reversed NFA back from there finds where it starts.
+//
+// Supported: literals, . [] [^] * + ? | () ^ $ and the escapes \d \w \s
+// (plus \D \W \S). ^ and $ match at the start and end of the row.
+#define RE_MAX_STATES 1024 // DFA states cached before the cache is flushed
+
+struct reProg;
+struct reDFA;
+
+struct regex {
+    struct reProg *fwd;
+    struct reProg *rev;
+    struct reDFA *fdfa; // caches are per regex, use reClone per thread
+    struct reDFA *rdfa;
+    int owner;          // frees the programs
+    int literal;        // no metacharacters at all, plain substring search
+    char *lit;          // the literal, or the literal every match starts with
+    int litlen;
+};
+
+struct regex *reCompile(const char *pattern);
+struct regex *reClone(struct regex *re);
+void reFree(struct regex *re);
+int reSearch(struct regex *re, const char *text, int len, int from,
+        int *start, int *end);
+#endif
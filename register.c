@@ -0,0 +1,76 @@
+#include <stdlib.h>
+
+#include "editorconfig.h"
+#include "register.h"
+#include "row.h"
+
+// register named by c, 0 (the unnamed one) for anything but a-z
+int regIndex(int c) {
+    return c >= 'a' && c <= 'z' ? c - 'a' + 1 : 0;
+}
+
+void regFree(struct editorConfig *E, struct reg *r) {
+    if (r->rows) eRowsRelease(r->rows, r->n, E);
+    r->rows = NULL;
+    r->n = 0;
+}
+
+// give the rows of every register their own copy of text they borrow from
+// the file's map, before it goes away
+void regOwn(struct editorConfig *E) {
+    int i, k;
+    for (i = 0; i < REG_COUNT; i++)
+        for (k = 0; k < E->regs[i].n; k++)
+            if (E->regs[i].rows[k].cap == 0) eRowOwn(&E->regs[i].rows[k], E);
+}
+
+// the erows of r with another reference taken on their text
+static erow *regShare(const erow *rows, int n) {
+    erow *copy = malloc(sizeof(erow) * n);
+    int i;
+    for (i = 0; i < n; i++) {
+        if (rows[i].cap) arRetain(rows[i].chars);
+        copy[i] = rows[i];
+    }
+    return copy;
+}
+
+// yank rows [at, at + n) into reg, a named register also fills the unnamed
+// one the way vim does
+void regYank(struct editorConfig *E, int reg, int at, int n) {
+    if (at < 0 || at >= E->numrows || n <= 0) return;
+    if (n > E->numrows - at) n = E->numrows - at;
+    eGapClose(E);
+
+    struct reg *r = &E->regs[reg];
+    regFree(E, r);
+    r->rows = malloc(sizeof(erow) * n);
+    r->n = n;
+
+    struct rsIter it;
+    erow *row = rsIterStart(&it, &E->rows, at);
+    int i;
+    for (i = 0; i < n; i++, row = rsIterNext(&it)) {
+        if (row->cap) arRetain(row->chars);
+        r->rows[i] = *row;
+    }
+
+    if (reg != 0) {
+        regFree(E, &E->regs[0]);
+        E->regs[0].rows = regShare(r->rows, n);
+        E->regs[0].n = n;
+    }
+}
+
+// put the rows of reg in before row at, returns how many went in
+int regPut(struct editorConfig *E, int reg, int at) {
+    struct reg *r = &E->regs[reg];
+    if (r->n == 0) return 0;
+    if (at > E->numrows) at = E->numrows;
+
+    erow *rows = regShare(r->rows, r->n);
+    ePutRows(at, rows, r->n, E);
+    free(rows);
+    unRows(E, UN_ADDROWS, at, NULL, r->n);
+    return r->n;
+}
@@ -0,0 +1,28 @@
+#ifndef REGISTER_H
+#define REGISTER_H
+
+#include "erow.h"
+
+/*** REGISTERS ***/
+// Yanked and deleted rows are kept in registers, the unnamed one plus a-z
+// picked with a leading "x. A register holds copies of the erows with a
+// reference to their text rather than the text itself, the same way a save
+// snapshot does, so yanking or putting a block of any size never copies a
+// byte of it. Whichever side is edited first takes its own copy of that
+// row (eRowOwn), and deleting the rows the register came from just drops
+// the buffer's reference.
+#define REG_COUNT 27 // unnamed plus a-z
+
+struct reg {
+    erow *rows;
+    int n;
+};
+
+struct editorConfig;
+
+int regIndex(int c);
+void regYank(struct editorConfig *E, int reg, int at, int n);
+int regPut(struct editorConfig *E, int reg, int at);
+void regFree(struct editorConfig *E, struct reg *r);
+void regOwn(struct editorConfig *E);
+#endif
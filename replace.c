@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "editorconfig.h"
+#include "regex.h"
+#include "replace.h"
+#include "row.h"
+#include "search.h"
+#include "utf8.h"
+
+static void rplPut(struct rplChunk *c, const char *s, size_t len) {
+    if (len == 0) return;
+    if (c->len + len > c->bufcap) {
+        while (c->len + len > c->bufcap)
+            c->bufcap = c->bufcap ? c->bufcap * 2 : 4096;
+        c->buf = realloc(c->buf, c->bufcap);
+    }
+    memcpy(&c->buf[c->len], s, len);
+    c->len += len;
+}
+
+// the replacement for chars[start..end)
+static void rplExpand(struct rplChunk *c, const char *rep, const char *chars,
+        int start, int end) {
+    const char *p = rep;
+    while (*p) {
+        size_t lit = strcspn(p, "&\\");
+        rplPut(c, p, lit);
+        p += lit;
+        if (*p == '&') {
+            rplPut(c, &chars[start], end - start);
+            p++;
+        } else if (*p == '\\') {
+            if (p[1]) rplPut(c, &p[1], 1);
+            p += p[1] ? 2 : 1;
+        }
+    }
+}
+
+// Build the replaced text of a row into c, returns 0 if nothing matched.
+// An empty match right where the last one ended doesn't count, the way vim
+// has s/x*/-/g turn "xxa" into "-a-".
+static int rplRow(struct rplChunk *c, struct replace *r, struct regex *re,
+        int at, const erow *row) {
+    const char *chars = row->chars;
+    int size = row->size;
+    size_t mark = c->len;
+    int from = 0, pos = -1, prev = -1, count = 0;
+    int col = 0;
+    int start, end;
+
+    while (from <= size && reSearch(re, chars, size, from, &start, &end)) {
+        if (start == end && start == prev) {
+            if (start == size) break;
+            int cp;
+            from = start + u8Decode(&chars[start], size - start, &cp);
+            continue;
+        }
+        if (pos == -1) {
+            col = pos = start;
+        }
+        rplPut(c, &chars[pos], start - pos);
+        rplExpand(c, r->rep, chars, start, end);
+        pos = prev = end;
+        count++;
+        if (c->len - mark > INT_MAX - (size_t)size) {
+            // the row would outgrow an int, leave it be
+            c->len = mark;
+            return 0;
+        }
+        if (!r->global) break;
+        if (start == end) {
+            if (end == size) break;
+            int cp;
+            from = end + u8Decode(&chars[end], size - end, &cp);
+        } else {
+            from = end;
+        }
+    }
+    if (count == 0) return 0;
+
+    if (c->nrow == c->cap) {
+        c->cap = c->cap ? c->cap * 2 : 64;
+        c->row = realloc(c->row, sizeof(struct rplRow) * c->cap);
+    }
+    struct rplRow *out = &c->row[c->nrow++];
+    out->at = at;
+    out->col = col;
+    out->n = pos - col;
+    out->off = mark;
+    out->len = c->len - mark;
+    out->count = count;
+    return 1;
+}
+
+static void *rplWorker(void *arg) {
+    struct replace *r = arg;
+    // each worker needs its own DFA cache
+    struct regex *re = reClone(r->re);
+    int k;
+
+    while ((k = __atomic_fetch_add(&r->next, 1, __ATOMIC_RELAXED)) < r->nchunk) {
+        struct rplChunk *c = &r->chunk[k];
+        struct rsIter it;
+        int at = c->start;
+        erow *row = rsIterStart(&it, &r->E->rows, at);
+        for (; row && at < c->end; row = rsIterNext(&it), at++)
+            rplRow(c, r, re, at, row);
+    }
+
+    reFree(re);
+    return NULL;
+}
+
+// replace matches of re in rows [first, last] with rep, counting what was
+// done in st. The whole change is one undo step with the key that asked.
+void rplRun(struct editorConfig *E, struct regex *re, const char *rep,
+        int global, int first, int last, struct rplStats *st) {
+    struct replace r;
+    pthread_t tid[RPL_MAX_THREADS];
+    int nthreads = 0;
+    int i, j;
+
+    st->count = 0;
+    st->lines = 0;
+    st->last = -1;
+    if (first < 0) first = 0;
+    if (last >= E->numrows) last = E->numrows - 1;
+    if (first > last) return;
+
+    // the workers only read the rows, nothing may be moving them
+    srchStop(&E->search);
+    eGapClose(E);
+
+    r.re = re;
+    r.rep = rep;
+    r.global = global;
+    r.E = E;
+    r.nchunk = (last - first) / RPL_CHUNK + 1;
+    r.chunk = calloc(r.nchunk, sizeof(struct rplChunk));
+    r.next = 0;
+    for (i = 0; i < r.nchunk; i++) {
+        r.chunk[i].start = first + i * RPL_CHUNK;
+        r.chunk[i].end = i == r.nchunk - 1 ? last + 1 : first + (i + 1) * RPL_CHUNK;
+    }
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int want = ncpu > RPL_MAX_THREADS ? RPL_MAX_THREADS : ncpu > 1 ? ncpu : 1;
+    if (want > r.nchunk) want = r.nchunk;
+    rsPin(&E->rows, 1);
+    if (want > 1) {
+        while (nthreads < want
+                && pthread_create(&tid[nthreads], NULL, rplWorker, &r) == 0)
+            nthreads++;
+    }
+    // with one chunk (a :s of one row) or no threads to be had, do it here
+    if (nthreads == 0) rplWorker(&r);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(tid[i], NULL);
+    rsPin(&E->rows, -1);
+
+    for (i = 0; i < r.nchunk; i++) {
+        struct rplChunk *c = &r.chunk[i];
+        for (j = 0; j < c->nrow; j++) {
+            struct rplRow *row = &c->row[j];
+            eRowSplice(row->at, row->col, row->n, &c->buf[row->off], row->len, E);
+            st->count += row->count;
+            st->lines++;
+            st->last = row->at;
+        }
+        free(c->row);
+        free(c->buf);
+    }
+    free(r.chunk);
+}
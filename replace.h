@@ -0,0 +1,59 @@
+#ifndef REPLACE_H
+#define REPLACE_H
+
+#include <stddef.h>
+
+/*** REPLACE ***/
+// :s and :%s. Each row with a match gets its new text built in one pass
+// over it: the span from the first match to the end of the last, with the
+// replacements in, goes into a per chunk buffer. Only then is the buffer
+// spliced into the rows, each one a single allocation for its new text and
+// one undo/journal record pair, so a whole file replace doesn't run an
+// edit per character. A whole file is split into RPL_CHUNK row chunks for
+// a pool of threads to build, much as a search is; the rows are only read
+// while they do, and the splicing is left to the UI thread.
+//
+// In the replacement & is the whole match and \ takes the next character
+// as it is (\& \\ \/).
+#define RPL_CHUNK 4096
+#define RPL_MAX_THREADS 16
+
+struct editorConfig;
+struct regex;
+
+// the replace of one row, text is buf[off..off + len) of its chunk
+struct rplRow {
+    int at;
+    int col, n;     // the span of the row that goes
+    size_t off;
+    int len;
+    int count;      // replacements made in it
+};
+
+struct rplChunk {
+    int start, end; // rows
+    struct rplRow *row;
+    int nrow, cap;
+    char *buf;
+    size_t len, bufcap;
+};
+
+struct replace {
+    struct regex *re;
+    const char *rep;
+    int global;     // every match in a row rather than the first
+    struct editorConfig *E;
+    struct rplChunk *chunk;
+    int nchunk;
+    int next;       // chunk the next worker takes, atomically
+};
+
+struct rplStats {
+    long count;     // replacements
+    int lines;      // rows changed
+    int last;       // the last of them, -1 for none
+};
+
+void rplRun(struct editorConfig *E, struct regex *re, const char *rep,
+        int global, int first, int last, struct rplStats *st);
+#endif
@@ -1,113 +1,669 @@
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "config.h"
 #include "editorconfig.h"
+#include "row.h"
+#include "utf8.h"
 
 /*** Row Ops ***/
-int eRowCxToRx(erow *row, int cx) {
-    int rx = 0;
+// text of a row laid out around the gap, if it has it: s[i] is byte i of
+// the text for i < end
+static const char *eRowSeg(int at, erow *row, int i, int *end,
+        struct editorConfig *E) {
+    if (at == E->gaprow) {
+        if (i < E->gap) {
+            *end = E->gap;
+            return row->chars;
+        }
+        *end = row->size;
+        return row->chars + E->gaplen;
+    }
+    *end = row->size;
+    return row->chars;
+}
+
+// column after the character at byte *i, moving *i past it
+static int eColStep(int at, erow *row, int *i, int col,
+        struct editorConfig *E) {
+    int end;
+    const char *s = eRowSeg(at, row, *i, &end, E);
+    if (s[*i] == '\t') {
+        (*i)++;
+        return col + ENVY_TAB_STOP - col % ENVY_TAB_STOP;
+    }
+    *i = u8Step(s, end, *i, &col);
+    return col;
+}
+
+// the column index for row `at`, if it is long enough to want one
+static struct colIndex *eColIndex(int at, erow *row, struct editorConfig *E) {
+    if (row->size < ROW_COLMIN) return NULL;
+
+    struct colIndex *idx = &E->cols[at % ROW_COLCACHE];
+    if (idx->row == at) return idx;
+
+    if (idx->cap == 0) {
+        idx->cap = 64;
+        idx->at = malloc(sizeof(int) * 2 * idx->cap);
+    }
+    idx->row = at;
+    idx->n = 1;
+    idx->at[0] = idx->at[1] = 0;
+    return idx;
+}
+
+// add checkpoints until there is one past byte `cx` or column `rx`,
+// whichever comes first, or the row runs out
+static void eColExtend(int at, struct colIndex *idx, erow *row, int cx, int rx,
+        struct editorConfig *E) {
+    int i = idx->at[2 * (idx->n - 1)];
+    int col = idx->at[2 * (idx->n - 1) + 1];
+
+    while (i < row->size && i <= cx && col <= rx) {
+        int next = i + ROW_COLSTEP;
+        while (i < row->size && i < next)
+            col = eColStep(at, row, &i, col, E);
+
+        if (idx->n == idx->cap) {
+            idx->cap *= 2;
+            idx->at = realloc(idx->at, sizeof(int) * 2 * idx->cap);
+        }
+        idx->at[2 * idx->n] = i;
+        idx->at[2 * idx->n + 1] = col;
+        idx->n++;
+    }
+}
+
+// last checkpoint at or before byte cx (by 0) or column rx (by 1)
+static int eColFind(struct colIndex *idx, int by, int v) {
+    int lo = 0, hi = idx->n - 1;
+    while (lo < hi) {
+        int mid = (lo + hi + 1) / 2;
+        if (idx->at[2 * mid + by] <= v) lo = mid;
+        else hi = mid - 1;
+    }
+    return lo;
+}
+
+// text of row `at` changed from byte col on, or with col -1 rows from `at`
+// on moved about
+static void eColsChanged(int at, int col, struct editorConfig *E) {
     int i;
-    for (i = 0; i < cx; i++) {
-        if (row->chars[i] == '\t')
-            rx += (ENVY_TAB_STOP - 1) - (rx % ENVY_TAB_STOP);
-        rx++;
+    for (i = 0; i < ROW_COLCACHE; i++) {
+        struct colIndex *idx = &E->cols[i];
+        if (idx->row == -1) continue;
+        if (col < 0 && idx->row >= at) {
+            idx->row = -1;
+        } else if (col >= 0 && idx->row == at) {
+            // a checkpoint at col itself may be in the middle of a
+            // character once the edit is done
+            while (idx->n > 1 && idx->at[2 * (idx->n - 1)] >= col) idx->n--;
+        }
+    }
+}
+
+// display column of byte offset cx
+int eRowCxToRx(int at, erow *row, int cx, struct editorConfig *E) {
+    int i = 0, rx = 0;
+    struct colIndex *idx = eColIndex(at, row, E);
+    if (idx) {
+        eColExtend(at, idx, row, cx, INT_MAX, E);
+        int k = eColFind(idx, 0, cx);
+        i = idx->at[2 * k];
+        rx = idx->at[2 * k + 1];
     }
+
+    while (i < cx && i < row->size)
+        rx = eColStep(at, row, &i, rx, E);
     return rx;
 }
 
-int erowRxToCx(erow *row, int rx) {
-    int cur_rx = 0;
-    int cx;
-    for (cx = 0; cx < row->size; cx++) {
-        if (row->chars[cx] == '\t')
-            cur_rx += (ENVY_TAB_STOP - 1) - (cur_rx % ENVY_TAB_STOP);
-        cur_rx++;
+// byte offset of the character covering display column rx
+int erowRxToCx(int at, erow *row, int rx, struct editorConfig *E) {
+    int cx = 0, cur_rx = 0;
+    struct colIndex *idx = eColIndex(at, row, E);
+    if (idx) {
+        eColExtend(at, idx, row, INT_MAX, rx, E);
+        int k = eColFind(idx, 1, rx);
+        cx = idx->at[2 * k];
+        cur_rx = idx->at[2 * k + 1];
+    }
 
+    while (cx < row->size) {
+        int next = cx;
+        cur_rx = eColStep(at, row, &next, cur_rx, E);
         if (cur_rx > rx) return cx;
+        cx = next;
     }
 
     return cx;
 }
 
-void eUpdateRow(erow *row) {
-    int tabs = 0;
-    int i;
-    for (i = 0; i < row->size; i++)
-        if (row->chars[i] == '\t') tabs++;
-
-    free(row->render);
-    row->render = malloc(row->size + tabs*(ENVY_TAB_STOP - 1) + 1);
-
-    int idx = 0;
-    for (i = 0; i < row->size; i++) {
-        if (row->chars[i] == '\t') {
-            row->render[idx++] = ' ';
-            while (idx % ENVY_TAB_STOP  != 0) row->render[idx++] = ' ';
-        } else {
-            row->render[idx++] = row->chars[i];
+// byte offset of the character before / after the one at cx
+int eRowPrev(int at, erow *row, int cx, struct editorConfig *E) {
+    char tmp[U8_MAX];
+    int from = cx > U8_MAX ? cx - U8_MAX : 0;
+    int i, end;
+    for (i = from; i < cx; i++)
+        tmp[i - from] = eRowSeg(at, row, i, &end, E)[i];
+    return from + u8Prev(tmp, cx - from);
+}
+
+int eRowNext(int at, erow *row, int cx, struct editorConfig *E) {
+    if (cx >= row->size) return row->size;
+    eColStep(at, row, &cx, 0, E);
+    return cx;
+}
+
+// the first n bytes of the row in one piece, copied out from around the
+// gap if need be. Only good until the next call.
+const char *eRowPrefix(int at, erow *row, int n, struct editorConfig *E) {
+    if (at != E->gaprow || n <= E->gap) return row->chars;
+    if (n > E->prefixcap) {
+        E->prefixcap = n;
+        E->prefix = realloc(E->prefix, E->prefixcap);
+    }
+    memcpy(E->prefix, row->chars, E->gap);
+    memcpy(&E->prefix[E->gap], &row->chars[E->gap + E->gaplen], n - E->gap);
+    return E->prefix;
+}
+
+// called whenever the text of row `at` changes or rows move about at it
+void eUpdateRow(int at, erow *row, struct editorConfig *E) {
+    if (row) row->hlend = SYN_STALE;
+    if (at < E->hlvalid) E->hlvalid = at;
+    E->rgen++;
+}
+
+// make room for n more bytes of render text and highlighting in slot
+static void eSlotRoom(struct renderSlot *slot, int n, struct editorConfig *E) {
+    if (slot->len + n + 1 > slot->cap)
+        slot->buf = arRealloc(&E->arena, slot->buf, slot->cap,
+                (slot->len + n + 1) * 2, &slot->cap);
+    if (slot->len + n + 1 > slot->hlcap)
+        slot->hl = (unsigned char *)arRealloc(&E->arena, (char *)slot->hl,
+                slot->hlcap, (slot->len + n + 1) * 2, &slot->hlcap);
+}
+
+static void eSlotPut(struct renderSlot *slot, const char *s, int n,
+        unsigned char hl, struct editorConfig *E) {
+    eSlotRoom(slot, n, E);
+    memcpy(&slot->buf[slot->len], s, n);
+    memset(&slot->hl[slot->len], hl, n);
+    slot->len += n;
+}
+
+static void eSlotSpaces(struct renderSlot *slot, int n, unsigned char hl,
+        struct editorConfig *E) {
+    eSlotRoom(slot, n, E);
+    memset(&slot->buf[slot->len], ' ', n);
+    memset(&slot->hl[slot->len], hl, n);
+    slot->len += n;
+}
+
+// The part of row `at` that is on screen, columns E->coloff on for
+// E->screencols, with tabs expanded and with a syntax in use its
+// highlighting in *hl. Only the window is ever worked on, so drawing a
+// row costs the same whatever its length. Renders are cached in a slot per
+// screen row, scrolling recycles the slots. Lexer states must be up to
+// date as far as `at` (synUpdate).
+char *eRowRender(int at, erow *row, int *len, unsigned char **hl,
+        struct editorConfig *E) {
+    *hl = NULL;
+
+    if (E->nrender < E->screenrows) {
+        int i;
+        E->render = realloc(E->render, sizeof(struct renderSlot) * E->screenrows);
+        for (i = E->nrender; i < E->screenrows; i++) {
+            E->render[i].cap = 0;
+            E->render[i].buf = NULL;
+            E->render[i].hlcap = 0;
+            E->render[i].hl = NULL;
+        }
+        for (i = 0; i < E->screenrows; i++)
+            E->render[i].row = -1;
+        E->nrender = E->screenrows;
+    }
+
+    struct renderSlot *slot = &E->render[at % E->nrender];
+    if (slot->row != at || slot->gen != E->rgen || slot->coloff != E->coloff
+            || slot->cols != E->screencols) {
+        int left = E->coloff, right = E->coloff + E->screencols;
+
+        // the lexer only looks at the first SYN_MAXCOL bytes of a row
+        int lexed = 0;
+        if (E->syntax) {
+            lexed = row->size < SYN_MAXCOL ? row->size : SYN_MAXCOL;
+            if (lexed > E->rowhlcap) {
+                E->rowhlcap = SYN_MAXCOL;
+                E->rowhl = realloc(E->rowhl, E->rowhlcap);
+            }
+            synLex(E->syntax, eRowPrefix(at, row, lexed, E), lexed,
+                    row->hlin, E->rowhl);
+        }
+
+        slot->len = 0;
+        int i = erowRxToCx(at, row, left, E);
+        int col = eRowCxToRx(at, row, i, E);
+        while (i < row->size && col < right) {
+            int end;
+            const char *s = eRowSeg(at, row, i, &end, E);
+            unsigned char h = i < lexed ? E->rowhl[i] : HL_NORMAL;
+            int start = i;
+            int next = eColStep(at, row, &i, col, E);
+
+            if (s[start] == '\t' || col < left || next > right) {
+                // a tab, or a wide character only partly in the window
+                int from = col < left ? left : col;
+                int to = next > right ? right : next;
+                if (to > from) eSlotSpaces(slot, to - from, h, E);
+            } else {
+                eSlotPut(slot, &s[start], i - start, h, E);
+            }
+            col = next;
         }
+        eSlotRoom(slot, 0, E);
+        slot->buf[slot->len] = '\0';
+        slot->row = at;
+        slot->gen = E->rgen;
+        slot->coloff = E->coloff;
+        slot->cols = E->screencols;
+    }
+
+    if (E->syntax) *hl = slot->hl;
+    *len = slot->len;
+    return slot->buf;
+}
+
+// give a row its own copy of its text to edit, when it is still reading
+// from the file map or someone else holds a reference to its text
+void eRowOwn(erow *row, struct editorConfig *E) {
+    srchStop(&E->search);
+    if (row->cap && !arShared(row->chars)) return;
+
+    int cap;
+    char *chars = arAlloc(&E->arena, row->size + 1, &cap);
+    memcpy(chars, row->chars, row->size);
+    chars[row->size] = '\0';
+    arFree(&E->arena, row->chars, row->cap);
+    row->chars = chars;
+    row->cap = cap;
+}
+
+// copy of every row sharing its text with the buffer, edits made while
+// the snapshot is held copy the row first (see eRowOwn)
+erow *eRowsSnapshot(struct editorConfig *E) {
+    eGapClose(E);
+    erow *rows = malloc(sizeof(erow) * (E->numrows ? E->numrows : 1));
+    struct rsIter it;
+    erow *row;
+    int i = 0;
+
+    for (row = rsIterStart(&it, &E->rows, 0); row; row = rsIterNext(&it)) {
+        if (row->cap) arRetain(row->chars);
+        rows[i++] = *row;
     }
-    row->render[idx] = '\0';
-    row->rsize = idx;
+    return rows;
+}
+
+// eRowsSnapshot for a file opened out of core: only rows in memory are
+// copied, the lines still on disk become pieces of the file to copy over
+erow *eRowsPieces(struct editorConfig *E, struct svPiece **pieces,
+        int *npieces, int *nrows) {
+    eGapClose(E);
+    struct rsRun *run;
+    int nrun = rsRuns(&E->rows, &run);
+    int total = 0;
+    int i, j;
+
+    for (i = 0; i < nrun; i++)
+        if (run[i].rows) total += run[i].n;
+
+    erow *rows = malloc(sizeof(erow) * (total ? total : 1));
+    struct svPiece *p = malloc(sizeof(struct svPiece) * (nrun ? nrun : 1));
+    int n = 0;
+    for (i = 0; i < nrun; i++) {
+        p[i].off = run[i].off;
+        p[i].len = run[i].len;
+        p[i].nl = run[i].nl;
+        p[i].first = n;
+        p[i].n = run[i].rows ? run[i].n : 0;
+        for (j = 0; j < p[i].n; j++) {
+            if (run[i].rows[j].cap) arRetain(run[i].rows[j].chars);
+            rows[n++] = run[i].rows[j];
+        }
+    }
+    free(run);
+
+    *pieces = p;
+    *npieces = nrun;
+    *nrows = n;
+    return rows;
+}
+
+void eRowsRelease(erow *rows, int n, struct editorConfig *E) {
+    int i;
+    for (i = 0; i < n; i++)
+        eFreeRow(&rows[i], E);
+    free(rows);
 }
 
 void eInsertRow(int at, char *s, size_t len, struct editorConfig *E) {
     if (at < 0 || at > E->numrows) return;
 
-    E->row = realloc(E->row, sizeof(erow) * (E->numrows + 1));
-    memmove(&E->row[at + 1], &E->row[at], sizeof(erow) * (E->numrows - at));
+    erow row;
+    row.size = len;
+    row.chars = arAlloc(&E->arena, len + 1, &row.cap);
+    memcpy(row.chars, s, len);
+    row.chars[len] = '\0';
+    ePutRows(at, &row, 1, E);
+    unRows(E, UN_ADDROWS, at, NULL, 1);
+}
+
+// the '\n' separated lines of s as rows with their own copy of the text,
+// in a malloc'd array of *count
+erow *eSplitLines(const char *s, size_t len, int *count,
+        struct editorConfig *E) {
+    int n = 0, cap = 64;
+    erow *rows = malloc(sizeof(erow) * cap);
+    const char *end = s + len;
+    while (1) {
+        const char *nl = memchr(s, '\n', end - s);
+        size_t size = (nl ? nl : end) - s;
+        if (n == cap) {
+            cap *= 2;
+            rows = realloc(rows, sizeof(erow) * cap);
+        }
+        erow *row = &rows[n++];
+        row->size = size;
+        row->chars = arAlloc(&E->arena, size + 1, &row->cap);
+        memcpy(row->chars, s, size);
+        row->chars[size] = '\0';
+        if (nl == NULL) break;
+        s = nl + 1;
+    }
+    *count = n;
+    return rows;
+}
+
+// put the '\n' separated lines of s in before row at all in one go,
+// returns how many rows that made
+int eInsertLines(int at, const char *s, size_t len, struct editorConfig *E) {
+    if (at < 0 || at > E->numrows) return 0;
+
+    int n;
+    erow *rows = eSplitLines(s, len, &n, E);
+    ePutRows(at, rows, n, E);
+    free(rows);
+    unRows(E, UN_ADDROWS, at, NULL, n);
+    return n;
+}
+
+// hand rows[0..n) over to the buffer at `at`, as they are
+void ePutRows(int at, erow *rows, int n, struct editorConfig *E) {
+    if (at < 0 || at > E->numrows || n <= 0) return;
+    if (E->jn.fd != -1) jnAddRows(&E->jn, at, rows, n);
+    eGapClose(E);
+    srchStop(&E->search);
+
+    int i;
+    for (i = 0; i < n; i++)
+        rows[i].hlend = SYN_STALE;
+    rsInsertRange(&E->rows, at, rows, n);
+    eUpdateRow(at, NULL, E);
+    eColsChanged(at, -1, E);
+
+    E->numrows += n;
+    E->dirty++;
+}
 
-    E->row[at].size = len;
-    E->row[at].chars = malloc(len + 1);
-    memcpy(E->row[at].chars, s, len);
-    E->row[at].chars[len] = '\0';
+// take rows [at, at + n) out of the buffer, text and all, returning them in
+// a malloc'd array
+erow *eTakeRows(int at, int n, struct editorConfig *E) {
+    if (at < 0 || n <= 0 || at + n > E->numrows) return NULL;
+    if (E->jn.fd != -1) jnDelRows(&E->jn, at, n);
+    eGapClose(E);
+    srchStop(&E->search);
+
+    erow *rows = malloc(sizeof(erow) * n);
+    rsDeleteRange(&E->rows, at, n, rows);
+    eUpdateRow(at, NULL, E);
+    eColsChanged(at, -1, E);
+
+    E->numrows -= n;
+    E->dirty++;
+    return rows;
+}
 
-    E->row[at].rsize = 0;
-    E->row[at].render = NULL;
-    eUpdateRow(&E->row[at]);
+// the rows of a file just read into buf, pointing into it without copying
+// it, buf must outlive them. nl holds the n newlines liScan found in it.
+void eMapRows(const char *buf, size_t len, const size_t *nl, size_t n,
+        struct editorConfig *E) {
+    if (E->numrows != 0) return;
+    eGapClose(E);
+    srchStop(&E->search);
 
-    E->numrows++;
+    E->numrows = rsLines(&E->rows, buf, len, nl, n);
+    eUpdateRow(0, NULL, E);
+    eColsChanged(0, -1, E);
     E->dirty++;
 }
 
-void eFreeRow(erow *row) {
-    free(row->render);
-    free(row->chars);
+void eFreeRow(erow *row, struct editorConfig *E) {
+    arFree(&E->arena, row->chars, row->cap);
+}
+
+// free the rows and everything row.c keeps about them
+void eFreeRows(struct editorConfig *E) {
+    struct rsIter it;
+    erow *row;
+    int i;
+
+    for (row = rsIterStart(&it, &E->rows, 0); row; row = rsIterNext(&it))
+        eFreeRow(row, E);
+    rsFree(&E->rows);
+    E->numrows = 0;
+    E->gaprow = -1;
+
+    for (i = 0; i < E->nrender; i++) {
+        arFree(&E->arena, E->render[i].buf, E->render[i].cap);
+        arFree(&E->arena, (char *)E->render[i].hl, E->render[i].hlcap);
+    }
+    free(E->render);
+    E->render = NULL;
+    E->nrender = 0;
+    for (i = 0; i < ROW_COLCACHE; i++) {
+        free(E->cols[i].at);
+        E->cols[i].at = NULL;
+        E->cols[i].row = -1;
+    }
+    free(E->prefix);
+    E->prefix = NULL;
+    free(E->rowhl);
+    E->rowhl = NULL;
+}
+
+// move row storage out of mostly empty slabs so they can be released,
+// called once deletes have left over half the arena unused
+void eCompactRows(struct editorConfig *E) {
+    struct rsIter it;
+    erow *row = NULL;
+
+    eGapClose(E);
+    if (arCompactBegin(&E->arena))
+        row = rsIterStart(&it, &E->rows, 0);
+    for (; row; row = rsIterNext(&it)) {
+        if (arMoving(&E->arena, row->chars, row->cap)) {
+            int cap;
+            char *chars = arAlloc(&E->arena, row->cap, &cap);
+            memcpy(chars, row->chars, row->size + 1);
+            arFree(&E->arena, row->chars, row->cap);
+            row->chars = chars;
+            row->cap = cap;
+        }
+    }
+
+    arCompactEnd(&E->arena);
 }
 
 void eDelRow(int at, struct editorConfig *E) {
+    eDelRows(at, 1, E);
+}
+
+// delete n rows, they go to the undo log rather than being freed
+void eDelRows(int at, int n, struct editorConfig *E) {
     if (at < 0 || at >= E->numrows) return;
-    eFreeRow(&E->row[at]);
-    memmove(&E->row[at], &E->row[at + 1], sizeof(erow) * (E->numrows - at - 1));
-    E->numrows--;
-    E->dirty++;
+    if (n > E->numrows - at) n = E->numrows - at;
+
+    erow *rows = eTakeRows(at, n, E);
+    if (!unRows(E, UN_DELROWS, at, rows, n))
+        eRowsRelease(rows, n, E);
+
+    if (arShouldCompact(&E->arena)) eCompactRows(E);
 }
 
-void eRowInsertChar(erow *row, int at, int c, struct editorConfig *E) {
-    if (at < 0 || at > row->size) at = row->size;
-    row->chars = realloc(row->chars, row->size + 2);
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-    row->size++;
-    row->chars[at] = c;
-    eUpdateRow(row);
-    E->dirty++;
+// close up the gap, leaving the row that had it in one piece again
+void eGapClose(struct editorConfig *E) {
+    if (E->gaprow == -1) return;
+    erow *row = rsGet(&E->rows, E->gaprow);
+    memmove(&row->chars[E->gap], &row->chars[E->gap + E->gaplen],
+            row->size - E->gap + 1);
+    E->gaprow = -1;
 }
 
-void eRowAppendString(erow *row, char *s, size_t len, struct editorConfig *E) {
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
+// move the gap in row `at` to col, making sure it has room for need bytes.
+// The row must own its text.
+static void eGapMove(int at, erow *row, int col, int need,
+        struct editorConfig *E) {
+    if (E->gaprow != at) {
+        // start out with the spare capacity at the end as the gap
+        eGapClose(E);
+        E->gaprow = at;
+        E->gap = row->size;
+        E->gaplen = row->cap - row->size - 1;
+        row->chars[row->cap - 1] = '\0';
+    }
+
+    if (col < E->gap)
+        memmove(&row->chars[col + E->gaplen], &row->chars[col], E->gap - col);
+    else if (col > E->gap)
+        memmove(&row->chars[E->gap], &row->chars[E->gap + E->gaplen],
+                col - E->gap);
+    E->gap = col;
+
+    if (E->gaplen < need) {
+        // grow by an eighth of the row so refilling it is amortized
+        int tail = row->size - col + 1;
+        row->chars = arRealloc(&E->arena, row->chars, row->cap,
+                row->size + need + row->size / 8 + 1, &row->cap);
+        memmove(&row->chars[row->cap - tail], &row->chars[col + E->gaplen], tail);
+        E->gaplen = row->cap - row->size - 1;
+    }
+}
+
+// put len bytes of s in row `at` before col
+void eRowInsert(int at, int col, const char *s, int len, struct editorConfig *E) {
+    erow *row = rsGet(&E->rows, at);
+    if (row == NULL) return;
+    if (col < 0 || col > row->size) col = row->size;
+    unText(E, UN_INSERT, at, col, s, len);
+    if (E->jn.fd != -1) jnInsert(&E->jn, at, col, s, len);
+    eRowOwn(row, E);
+    eColsChanged(at, col, E);
+    if (at == E->gaprow || row->size + len >= ROW_GAPMIN) {
+        eGapMove(at, row, col, len, E);
+        memcpy(&row->chars[col], s, len);
+        E->gap += len;
+        E->gaplen -= len;
+    } else {
+        row->chars = arRealloc(&E->arena, row->chars, row->cap,
+                row->size + len + 1, &row->cap);
+        memmove(&row->chars[col + len], &row->chars[col], row->size - col + 1);
+        memcpy(&row->chars[col], s, len);
+    }
     row->size += len;
-    row->chars[row->size] = '\0';
-    eUpdateRow(row);
+    rsResize(&E->rows, at, len);
+    eUpdateRow(at, row, E);
+    E->dirty++;
+}
+
+// take n bytes out of row `at` from col on
+void eRowDelete(int at, int col, int n, struct editorConfig *E) {
+    erow *row = rsGet(&E->rows, at);
+    if (row == NULL || col < 0 || col >= row->size) return;
+    if (n > row->size - col) n = row->size - col;
+    if (E->jn.fd != -1) jnDelete(&E->jn, at, col, n);
+    eRowOwn(row, E);
+    eColsChanged(at, col, E);
+    if (at == E->gaprow || row->size >= ROW_GAPMIN) {
+        // what goes is just after the gap once it has moved to col
+        eGapMove(at, row, col, 0, E);
+        unText(E, UN_DELETE, at, col, &row->chars[col + E->gaplen], n);
+        E->gaplen += n;
+    } else {
+        unText(E, UN_DELETE, at, col, &row->chars[col], n);
+        memmove(&row->chars[col], &row->chars[col + n], row->size - col - n + 1);
+    }
+    row->size -= n;
+    rsResize(&E->rows, at, -n);
+    eUpdateRow(at, row, E);
     E->dirty++;
 }
 
-void eRowDelChar(erow *row, int at, struct editorConfig *E) {
-    if (at < 0 || at >= row->size) return;
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
-    eUpdateRow(row);
+// put len bytes of s in place of the n bytes of row `at` from col, building
+// the new text in one allocation rather than as a delete and an insert
+void eRowSplice(int at, int col, int n, const char *s, int len,
+        struct editorConfig *E) {
+    erow *row = rsGet(&E->rows, at);
+    if (row == NULL || col < 0 || col > row->size) return;
+    if (n > row->size - col) n = row->size - col;
+    eGapClose(E);
+    srchStop(&E->search);
+    // not to be run together with typing that went before
+    E->undo.open = 0;
+    unText(E, UN_DELETE, at, col, &row->chars[col], n);
+    unText(E, UN_INSERT, at, col, s, len);
+    if (E->jn.fd != -1) {
+        jnDelete(&E->jn, at, col, n);
+        jnInsert(&E->jn, at, col, s, len);
+    }
+    eColsChanged(at, col, E);
+
+    int size = row->size - n + len;
+    int cap;
+    char *chars = arAlloc(&E->arena, size + 1, &cap);
+    memcpy(chars, row->chars, col);
+    memcpy(&chars[col], s, len);
+    memcpy(&chars[col + len], &row->chars[col + n], row->size - col - n);
+    chars[size] = '\0';
+    arFree(&E->arena, row->chars, row->cap);
+    row->chars = chars;
+    row->cap = cap;
+    row->size = size;
+    rsResize(&E->rows, at, len - n);
+    eUpdateRow(at, row, E);
     E->dirty++;
 }
 
+void eRowInsertChar(int at, int col, int c, struct editorConfig *E) {
+    char ch = c;
+    eRowInsert(at, col, &ch, 1, E);
+}
+
+void eRowAppendString(int at, char *s, size_t len, struct editorConfig *E) {
+    erow *row = rsGet(&E->rows, at);
+    if (row == NULL) return;
+    eRowInsert(at, row->size, s, len, E);
+}
+
+void eRowDelChar(int at, int col, struct editorConfig *E) {
+    eRowDelete(at, col, 1, E);
+}
+
+void eRowTruncate(int at, int col, struct editorConfig *E) {
+    erow *row = rsGet(&E->rows, at);
+    if (row == NULL) return;
+    eRowDelete(at, col, row->size - col, E);
+}
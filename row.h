@@ -1,10 +1,37 @@
 //#include "editorconfig.h"
 
-int erowRxToCx(erow *row, int rx);
-void eUpdateRow(erow *row);
+int eRowCxToRx(int at, erow *row, int cx, struct editorConfig *E);
+int erowRxToCx(int at, erow *row, int rx, struct editorConfig *E);
+int eRowPrev(int at, erow *row, int cx, struct editorConfig *E);
+int eRowNext(int at, erow *row, int cx, struct editorConfig *E);
+const char *eRowPrefix(int at, erow *row, int n, struct editorConfig *E);
+void eGapClose(struct editorConfig *E);
+void eUpdateRow(int at, erow *row, struct editorConfig *E);
+char *eRowRender(int at, erow *row, int *len, unsigned char **hl,
+        struct editorConfig *E);
+void eRowOwn(erow *row, struct editorConfig *E);
+erow *eRowsSnapshot(struct editorConfig *E);
+erow *eRowsPieces(struct editorConfig *E, struct svPiece **pieces,
+        int *npieces, int *nrows);
+void eRowsRelease(erow *rows, int n, struct editorConfig *E);
 void eInsertRow(int at, char *s, size_t len, struct editorConfig *E);
-void eFreeRow(erow *row);
+erow *eSplitLines(const char *s, size_t len, int *count,
+        struct editorConfig *E);
+int eInsertLines(int at, const char *s, size_t len, struct editorConfig *E);
+void ePutRows(int at, erow *rows, int n, struct editorConfig *E);
+erow *eTakeRows(int at, int n, struct editorConfig *E);
+void eMapRows(const char *buf, size_t len, const size_t *nl, size_t n,
+        struct editorConfig *E);
+void eFreeRow(erow *row, struct editorConfig *E);
+void eFreeRows(struct editorConfig *E);
+void eCompactRows(struct editorConfig *E);
 void eDelRow(int at, struct editorConfig *E);
-void eRowInsertChar(erow *row, int at, int c, struct editorConfig *E);
-void eRowAppendString(erow *row, char *s, size_t len, struct editorConfig *E);
-void eRowDelChar(erow *row, int at, struct editorConfig *E);
+void eDelRows(int at, int n, struct editorConfig *E);
+void eRowInsert(int at, int col, const char *s, int len, struct editorConfig *E);
+void eRowDelete(int at, int col, int n, struct editorConfig *E);
+void eRowSplice(int at, int col, int n, const char *s, int len,
+        struct editorConfig *E);
+void eRowInsertChar(int at, int col, int c, struct editorConfig *E);
+void eRowAppendString(int at, char *s, size_t len, struct editorConfig *E);
+void eRowDelChar(int at, int col, struct editorConfig *E);
+void eRowTruncate(int at, int col, struct editorConfig *E);
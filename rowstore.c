@@ -0,0 +1,884 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "rowstore.h"
+#include "syntax.h"
+
+struct rsNode {
+    int leaf;
+    int n; // rows in a leaf, children in an inner node
+};
+
+struct rsLeaf {
+    struct rsNode h;
+    struct rsLeaf *prev, *next;
+    erow *row;       // RS_LEAF_MAX of them, NULL while the leaf is on disk
+    size_t off, len; // its lines in the backing file, len 0 for none
+    size_t bytes;    // its rows' sizes plus a newline each
+    int cached;      // on the LRU list of clean loaded leaves
+    struct rsLeaf *newer, *older;
+};
+
+struct rsInner {
+    struct rsNode h;
+    int count[RS_FANOUT]; // rows below each child
+    size_t bytes[RS_FANOUT]; // and their bytes, see rsOffset
+    struct rsNode *child[RS_FANOUT];
+};
+
+static struct rsLeaf *rsNewLeaf(int rows) {
+    struct rsLeaf *leaf = malloc(sizeof(struct rsLeaf));
+    leaf->h.leaf = 1;
+    leaf->h.n = 0;
+    leaf->prev = leaf->next = NULL;
+    leaf->row = rows ? malloc(sizeof(erow) * RS_LEAF_MAX) : NULL;
+    leaf->off = leaf->len = leaf->bytes = 0;
+    leaf->cached = 0;
+    leaf->newer = leaf->older = NULL;
+    return leaf;
+}
+
+static struct rsInner *rsNewInner() {
+    struct rsInner *in = malloc(sizeof(struct rsInner));
+    in->h.leaf = 0;
+    in->h.n = 0;
+    return in;
+}
+
+/*** backing file ***/
+// read the line at p into row, returns where the next one starts
+static const char *rsLine(const char *p, const char *end, erow *row) {
+    const char *nl = memchr(p, '\n', end - p);
+    size_t size = (nl ? nl : end) - p;
+    // the same as eOpen, a last line without a newline loses a '\r'
+    if (nl == NULL && size > 0 && p[size - 1] == '\r') size--;
+    row->size = size;
+    row->cap = 0;
+    row->chars = (char *)p;
+    row->hlin = 0;
+    row->hlend = SYN_STALE;
+    return nl ? nl + 1 : end;
+}
+
+// what the rows rsLine reads out of an extent add up to, the file's last
+// line may be missing its newline and have lost a '\r'
+static size_t rsExtentBytes(const char *base, size_t off, size_t len) {
+    if (len == 0) return 0;
+    const char *end = base + off + len;
+    if (end[-1] == '\n') return len;
+    return end[-1] == '\r' ? len : len + 1;
+}
+
+static void rsUncache(struct rowStore *rs, struct rsLeaf *leaf) {
+    if (!leaf->cached) return;
+    if (leaf->newer) leaf->newer->older = leaf->older;
+    else rs->newest = leaf->older;
+    if (leaf->older) leaf->older->newer = leaf->newer;
+    else rs->oldest = leaf->newer;
+    leaf->cached = 0;
+    rs->nloaded--;
+}
+
+static void rsCache(struct rowStore *rs, struct rsLeaf *leaf) {
+    leaf->older = rs->newest;
+    leaf->newer = NULL;
+    if (rs->newest) rs->newest->newer = leaf;
+    else rs->oldest = leaf;
+    rs->newest = leaf;
+    leaf->cached = 1;
+    rs->nloaded++;
+}
+
+// give a leaf on disk its rows, and either way mark it as just used
+static void rsLoad(struct rowStore *rs, struct rsLeaf *leaf) {
+    if (leaf->row) {
+        if (leaf->cached && rs->newest != leaf) {
+            rsUncache(rs, leaf);
+            rsCache(rs, leaf);
+        }
+        return;
+    }
+
+    erow *row = malloc(sizeof(erow) * RS_LEAF_MAX);
+    const char *p = rs->base + leaf->off;
+    const char *end = p + leaf->len;
+    int i;
+    for (i = 0; i < leaf->h.n; i++)
+        p = rsLine(p, end, &row[i]);
+
+    pthread_mutex_lock(&rs->lock);
+    leaf->row = row;
+    pthread_mutex_unlock(&rs->lock);
+    rsCache(rs, leaf);
+}
+
+// whether a loaded leaf's rows are still exactly its lines of the file
+static int rsClean(struct rowStore *rs, struct rsLeaf *leaf) {
+    const char *p = rs->base + leaf->off;
+    const char *end = p + leaf->len;
+    int i;
+
+    if (leaf->len == 0) return 0;
+    for (i = 0; i < leaf->h.n; i++) {
+        erow line;
+        erow *row = &leaf->row[i];
+        if (p >= end) return 0;
+        const char *next = rsLine(p, end, &line);
+        if (row->cap || row->chars != p || row->size != line.size) return 0;
+        p = next;
+    }
+    return p == end;
+}
+
+static void rsFreeLeaf(struct rowStore *rs, struct rsLeaf *leaf) {
+    rsUncache(rs, leaf);
+    if (rs->hint == leaf) rs->hint = NULL;
+    free(leaf->row);
+    free(leaf);
+}
+
+static int rsTotal(struct rsNode *n) {
+    if (n->leaf) return n->n;
+
+    struct rsInner *in = (struct rsInner *)n;
+    int total = 0;
+    int i;
+    for (i = 0; i < in->h.n; i++)
+        total += in->count[i];
+    return total;
+}
+
+static size_t rsTotalBytes(struct rsNode *n) {
+    if (n->leaf) return ((struct rsLeaf *)n)->bytes;
+
+    struct rsInner *in = (struct rsInner *)n;
+    size_t total = 0;
+    int i;
+    for (i = 0; i < in->h.n; i++)
+        total += in->bytes[i];
+    return total;
+}
+
+// bytes of rows [from, to) of a loaded leaf
+static size_t rsLeafBytes(struct rsLeaf *leaf, int from, int to) {
+    size_t total = 0;
+    int i;
+    for (i = from; i < to; i++)
+        total += leaf->row[i].size + 1;
+    return total;
+}
+
+// walk down to the leaf holding row *at, leaving *at as the offset within
+// that leaf and the inner nodes/child slots we went through in path/slot
+static struct rsLeaf *rsFind(struct rowStore *rs, int *at,
+        struct rsInner **path, int *slot, int *depth) {
+    struct rsNode *n = rs->root;
+    int d = 0;
+
+    while (!n->leaf) {
+        struct rsInner *in = (struct rsInner *)n;
+        int i;
+        for (i = 0; i < in->h.n - 1 && *at >= in->count[i]; i++)
+            *at -= in->count[i];
+        path[d] = in;
+        slot[d] = i;
+        d++;
+        n = in->child[i];
+    }
+
+    *depth = d;
+    return (struct rsLeaf *)n;
+}
+
+// hang node off the tree as the right hand sibling of left, which sits at
+// path[d]->child[slot[d]], splitting inner nodes upwards as they fill
+static void rsAddSibling(struct rowStore *rs, struct rsInner **path, int *slot,
+        int d, struct rsNode *left, struct rsNode *node) {
+    if (d < 0) {
+        struct rsInner *root = rsNewInner();
+        root->child[0] = left;
+        root->count[0] = rsTotal(left);
+        root->bytes[0] = rsTotalBytes(left);
+        root->child[1] = node;
+        root->count[1] = rsTotal(node);
+        root->bytes[1] = rsTotalBytes(node);
+        root->h.n = 2;
+        rs->root = (struct rsNode *)root;
+        return;
+    }
+
+    struct rsInner *p = path[d];
+    struct rsInner *target = p;
+    int i = slot[d];
+    p->count[i] = rsTotal(left);
+    p->bytes[i] = rsTotalBytes(left);
+
+    struct rsInner *right = NULL;
+    if (p->h.n == RS_FANOUT) {
+        int half = RS_FANOUT / 2;
+        right = rsNewInner();
+        memcpy(right->child, &p->child[half], sizeof(p->child[0]) * half);
+        memcpy(right->count, &p->count[half], sizeof(p->count[0]) * half);
+        memcpy(right->bytes, &p->bytes[half], sizeof(p->bytes[0]) * half);
+        right->h.n = RS_FANOUT - half;
+        p->h.n = half;
+        if (i >= half) {
+            target = right;
+            i -= half;
+        }
+    }
+
+    i++;
+    memmove(&target->child[i + 1], &target->child[i],
+            sizeof(target->child[0]) * (target->h.n - i));
+    memmove(&target->count[i + 1], &target->count[i],
+            sizeof(target->count[0]) * (target->h.n - i));
+    memmove(&target->bytes[i + 1], &target->bytes[i],
+            sizeof(target->bytes[0]) * (target->h.n - i));
+    target->child[i] = node;
+    target->count[i] = rsTotal(node);
+    target->bytes[i] = rsTotalBytes(node);
+    target->h.n++;
+
+    if (right)
+        rsAddSibling(rs, path, slot, d - 1,
+                (struct rsNode *)p, (struct rsNode *)right);
+}
+
+// drop path[d]->child[slot[d]] from the tree, freeing inner nodes that end
+// up with no children
+static void rsRemoveChild(struct rowStore *rs, struct rsInner **path, int *slot,
+        int d) {
+    struct rsInner *p = path[d];
+    int i = slot[d];
+
+    memmove(&p->child[i], &p->child[i + 1],
+            sizeof(p->child[0]) * (p->h.n - i - 1));
+    memmove(&p->count[i], &p->count[i + 1],
+            sizeof(p->count[0]) * (p->h.n - i - 1));
+    memmove(&p->bytes[i], &p->bytes[i + 1],
+            sizeof(p->bytes[0]) * (p->h.n - i - 1));
+    p->h.n--;
+
+    if (p->h.n == 0) {
+        free(p);
+        if (d > 0)
+            rsRemoveChild(rs, path, slot, d - 1);
+        else
+            rs->root = NULL;
+    }
+}
+
+static void rsUnlinkLeaf(struct rowStore *rs, struct rsLeaf *leaf) {
+    if (leaf->prev) leaf->prev->next = leaf->next;
+    if (leaf->next) leaf->next->prev = leaf->prev;
+    rsFreeLeaf(rs, leaf);
+}
+
+void rsInit(struct rowStore *rs) {
+    rs->root = NULL;
+    rs->hint = NULL;
+    rs->hintstart = 0;
+    rs->base = NULL;
+    rs->cache = 0;
+    rs->nloaded = 0;
+    rs->pinned = 0;
+    rs->newest = rs->oldest = NULL;
+    pthread_mutex_init(&rs->lock, NULL);
+}
+
+erow *rsGet(struct rowStore *rs, int at) {
+    if (at < 0 || rs->root == NULL) return NULL;
+
+    if (rs->hint && at >= rs->hintstart && at < rs->hintstart + rs->hint->h.n)
+        return &rs->hint->row[at - rs->hintstart];
+
+    struct rsInner *path[RS_MAXDEPTH];
+    int slot[RS_MAXDEPTH];
+    int depth;
+    int off = at;
+    struct rsLeaf *leaf = rsFind(rs, &off, path, slot, &depth);
+    if (off >= leaf->h.n) return NULL;
+
+    rsLoad(rs, leaf);
+    rs->hint = leaf;
+    rs->hintstart = at - off;
+    return &leaf->row[off];
+}
+
+// make room for a row at `at` and hand back the (uninitialised) slot, which
+// counts as an empty line until rsResize says otherwise
+erow *rsInsert(struct rowStore *rs, int at) {
+    struct rsInner *path[RS_MAXDEPTH];
+    int slot[RS_MAXDEPTH];
+    int depth;
+    int off = at;
+
+    rs->hint = NULL;
+    if (rs->root == NULL)
+        rs->root = (struct rsNode *)rsNewLeaf(1);
+
+    struct rsLeaf *leaf = rsFind(rs, &off, path, slot, &depth);
+    rsLoad(rs, leaf);
+    if (leaf->h.n == RS_LEAF_MAX) {
+        // appending past a full leaf (the file load case) starts a fresh
+        // leaf rather than leaving a trail of half empty ones behind
+        int keep = (off == RS_LEAF_MAX) ? RS_LEAF_MAX : RS_LEAF_MAX / 2;
+        struct rsLeaf *right = rsNewLeaf(1);
+        memcpy(right->row, &leaf->row[keep], sizeof(erow) * (RS_LEAF_MAX - keep));
+        right->h.n = RS_LEAF_MAX - keep;
+        leaf->h.n = keep;
+        right->bytes = rsLeafBytes(right, 0, right->h.n);
+        leaf->bytes -= right->bytes;
+
+        right->prev = leaf;
+        right->next = leaf->next;
+        if (leaf->next) leaf->next->prev = right;
+        leaf->next = right;
+
+        rsAddSibling(rs, path, slot, depth - 1,
+                (struct rsNode *)leaf, (struct rsNode *)right);
+
+        off = at;
+        leaf = rsFind(rs, &off, path, slot, &depth);
+    }
+
+    memmove(&leaf->row[off + 1], &leaf->row[off],
+            sizeof(erow) * (leaf->h.n - off));
+    leaf->h.n++;
+    leaf->bytes++;
+
+    int d;
+    for (d = 0; d < depth; d++) {
+        path[d]->count[slot[d]]++;
+        path[d]->bytes[slot[d]]++;
+    }
+
+    return &leaf->row[off];
+}
+
+// remove the row at `at`, the caller is expected to have freed its contents
+void rsDelete(struct rowStore *rs, int at) {
+    struct rsInner *path[RS_MAXDEPTH];
+    int slot[RS_MAXDEPTH];
+    int depth;
+    int off = at;
+
+    if (at < 0 || rs->root == NULL) return;
+    rs->hint = NULL;
+
+    struct rsLeaf *leaf = rsFind(rs, &off, path, slot, &depth);
+    if (off >= leaf->h.n) return;
+    rsLoad(rs, leaf);
+
+    size_t bytes = leaf->row[off].size + 1;
+    memmove(&leaf->row[off], &leaf->row[off + 1],
+            sizeof(erow) * (leaf->h.n - off - 1));
+    leaf->h.n--;
+    leaf->bytes -= bytes;
+
+    int d;
+    for (d = 0; d < depth; d++) {
+        path[d]->count[slot[d]]--;
+        path[d]->bytes[slot[d]] -= bytes;
+    }
+
+    if (depth == 0) {
+        if (leaf->h.n == 0) {
+            rsFreeLeaf(rs, leaf);
+            rs->root = NULL;
+        }
+        return;
+    }
+
+    struct rsInner *p = path[depth - 1];
+    int i = slot[depth - 1];
+
+    if (leaf->h.n == 0) {
+        rsRemoveChild(rs, path, slot, depth - 1);
+        rsUnlinkLeaf(rs, leaf);
+    } else if (leaf->h.n < RS_LEAF_MAX / 4 && i + 1 < p->h.n
+            && leaf->h.n + p->child[i + 1]->n <= RS_LEAF_MAX / 2) {
+        // fold a small leaf's right hand neighbour into it so a run of
+        // deletes doesn't leave the tree full of near empty leaves
+        struct rsLeaf *next = (struct rsLeaf *)p->child[i + 1];
+        rsLoad(rs, next);
+        memcpy(&leaf->row[leaf->h.n], next->row, sizeof(erow) * next->h.n);
+        leaf->h.n += next->h.n;
+        leaf->bytes += next->bytes;
+        p->count[i] += next->h.n;
+        p->bytes[i] += next->bytes;
+        slot[depth - 1] = i + 1;
+        rsRemoveChild(rs, path, slot, depth - 1);
+        rsUnlinkLeaf(rs, next);
+    }
+
+    // collapse single child roots
+    while (rs->root && !rs->root->leaf && rs->root->n == 1) {
+        struct rsInner *old = (struct rsInner *)rs->root;
+        rs->root = old->child[0];
+        free(old);
+    }
+}
+
+/*** byte offsets ***/
+// the inner nodes keep the bytes below each child next to the row count,
+// every row counted as its size plus a newline, which is what it takes up
+// in the saved file. Growing or shrinking a row in place goes through
+// rsResize so the sums on its path follow.
+void rsResize(struct rowStore *rs, int at, int delta) {
+    struct rsInner *path[RS_MAXDEPTH];
+    int slot[RS_MAXDEPTH];
+    int depth;
+    int off = at;
+
+    if (at < 0 || rs->root == NULL || delta == 0) return;
+    struct rsLeaf *leaf = rsFind(rs, &off, path, slot, &depth);
+    if (off >= leaf->h.n) return;
+
+    leaf->bytes += delta;
+    int d;
+    for (d = 0; d < depth; d++)
+        path[d]->bytes[slot[d]] += delta;
+}
+
+// bytes of the rows of leaf before row n, read out of the map if the leaf
+// is on disk so looking doesn't load it
+static size_t rsLeafOffset(struct rowStore *rs, struct rsLeaf *leaf, int n) {
+    size_t total = 0;
+    int i;
+
+    if (leaf->row) return rsLeafBytes(leaf, 0, n);
+
+    const char *p = rs->base + leaf->off;
+    const char *end = p + leaf->len;
+    for (i = 0; i < n; i++) {
+        erow line;
+        p = rsLine(p, end, &line);
+        total += line.size + 1;
+    }
+    return total;
+}
+
+// where row at starts, the total size for at past the last row
+size_t rsOffset(struct rowStore *rs, int at) {
+    struct rsNode *n = rs->root;
+    size_t total = 0;
+
+    if (at <= 0 || n == NULL) return 0;
+    while (!n->leaf) {
+        struct rsInner *in = (struct rsInner *)n;
+        int i;
+        for (i = 0; i < in->h.n - 1 && at >= in->count[i]; i++) {
+            at -= in->count[i];
+            total += in->bytes[i];
+        }
+        n = in->child[i];
+    }
+
+    struct rsLeaf *leaf = (struct rsLeaf *)n;
+    if (at >= leaf->h.n) return total + leaf->bytes;
+    return total + rsLeafOffset(rs, leaf, at);
+}
+
+// the row byte pos is in, with where that row starts in *start. Past the
+// end is the last row, -1 for an empty store.
+int rsRowAt(struct rowStore *rs, size_t pos, size_t *start) {
+    struct rsNode *n = rs->root;
+    size_t skipped = 0;
+    int at = 0;
+
+    *start = 0;
+    if (n == NULL) return -1;
+    while (!n->leaf) {
+        struct rsInner *in = (struct rsInner *)n;
+        int i;
+        for (i = 0; i < in->h.n - 1 && pos >= skipped + in->bytes[i]; i++) {
+            skipped += in->bytes[i];
+            at += in->count[i];
+        }
+        n = in->child[i];
+    }
+
+    struct rsLeaf *leaf = (struct rsLeaf *)n;
+    erow *row = leaf->row;
+    const char *p = rs->base + leaf->off;
+    const char *end = p + leaf->len;
+    int i;
+    for (i = 0; i < leaf->h.n; i++) {
+        erow line;
+        if (row) line = row[i];
+        else p = rsLine(p, end, &line);
+        if (i == leaf->h.n - 1 || pos < skipped + line.size + 1) break;
+        skipped += line.size + 1;
+    }
+
+    *start = skipped;
+    return at + i;
+}
+
+/*** ranges ***/
+static struct rsLeaf *rsFirstLeaf(struct rowStore *rs) {
+    struct rsNode *n = rs->root;
+    while (n && !n->leaf)
+        n = ((struct rsInner *)n)->child[0];
+    return (struct rsLeaf *)n;
+}
+
+static void rsFreeInner(struct rsNode *n) {
+    if (n == NULL || n->leaf) return;
+
+    struct rsInner *in = (struct rsInner *)n;
+    int i;
+    for (i = 0; i < in->h.n; i++)
+        rsFreeInner(in->child[i]);
+    free(in);
+}
+
+// free the leaves and nodes, the text of the rows is for the owner to free
+void rsFree(struct rowStore *rs) {
+    struct rsLeaf *leaf = rsFirstLeaf(rs);
+    rsFreeInner(rs->root);
+    while (leaf) {
+        struct rsLeaf *next = leaf->next;
+        free(leaf->row);
+        free(leaf);
+        leaf = next;
+    }
+    pthread_mutex_destroy(&rs->lock);
+    rs->root = NULL;
+    rs->hint = NULL;
+}
+
+// throw away the inner nodes and build fresh ones over the chain of leaves
+// starting at first, dropping any leaves left empty on the way
+static void rsRebuild(struct rowStore *rs, struct rsLeaf *first) {
+    rsFreeInner(rs->root);
+    rs->root = NULL;
+    rs->hint = NULL;
+
+    int n = 0;
+    struct rsLeaf *head = NULL;
+    struct rsLeaf *leaf = first;
+    while (leaf) {
+        struct rsLeaf *next = leaf->next;
+        if (leaf->h.n == 0) {
+            rsUnlinkLeaf(rs, leaf);
+        } else {
+            if (head == NULL) head = leaf;
+            n++;
+        }
+        leaf = next;
+    }
+    if (n == 0) return;
+
+    struct rsNode **level = malloc(sizeof(struct rsNode *) * n);
+    int i = 0;
+    for (leaf = head; leaf; leaf = leaf->next)
+        level[i++] = (struct rsNode *)leaf;
+
+    while (n > 1) {
+        int m = 0;
+        for (i = 0; i < n; i += RS_FANOUT) {
+            struct rsInner *in = rsNewInner();
+            int j;
+            for (j = 0; j < RS_FANOUT && i + j < n; j++) {
+                in->child[j] = level[i + j];
+                in->count[j] = rsTotal(level[i + j]);
+                in->bytes[j] = rsTotalBytes(level[i + j]);
+            }
+            in->h.n = j;
+            level[m++] = (struct rsNode *)in;
+        }
+        n = m;
+    }
+    rs->root = level[0];
+    free(level);
+}
+
+// put rows[0..n) in at `at`, taking the rows over as they are
+void rsInsertRange(struct rowStore *rs, int at, const erow *rows, int n) {
+    if (n < RS_LEAF_MAX) {
+        int i;
+        for (i = 0; i < n; i++) {
+            *rsInsert(rs, at + i) = rows[i];
+            rsResize(rs, at + i, rows[i].size);
+        }
+        return;
+    }
+
+    struct rsLeaf *leaf = NULL;
+    int off = 0;
+    if (rs->root) {
+        struct rsInner *path[RS_MAXDEPTH];
+        int slot[RS_MAXDEPTH];
+        int depth;
+        off = at;
+        leaf = rsFind(rs, &off, path, slot, &depth);
+        rsLoad(rs, leaf);
+    }
+
+    // split the leaf at the insert point, the new leaves go in between
+    if (leaf && off < leaf->h.n) {
+        struct rsLeaf *tail = rsNewLeaf(1);
+        memcpy(tail->row, &leaf->row[off], sizeof(erow) * (leaf->h.n - off));
+        tail->h.n = leaf->h.n - off;
+        leaf->h.n = off;
+        tail->bytes = rsLeafBytes(tail, 0, tail->h.n);
+        leaf->bytes -= tail->bytes;
+        tail->prev = leaf;
+        tail->next = leaf->next;
+        if (leaf->next) leaf->next->prev = tail;
+        leaf->next = tail;
+    }
+
+    struct rsLeaf *first = leaf ? rsFirstLeaf(rs) : NULL;
+    struct rsLeaf *prev = leaf;
+    int i;
+    for (i = 0; i < n; i += RS_LEAF_MAX) {
+        struct rsLeaf *fresh = rsNewLeaf(1);
+        int take = n - i < RS_LEAF_MAX ? n - i : RS_LEAF_MAX;
+        memcpy(fresh->row, &rows[i], sizeof(erow) * take);
+        fresh->h.n = take;
+        fresh->bytes = rsLeafBytes(fresh, 0, take);
+        fresh->prev = prev;
+        fresh->next = prev ? prev->next : NULL;
+        if (fresh->next) fresh->next->prev = fresh;
+        if (prev) prev->next = fresh;
+        if (first == NULL) first = fresh;
+        prev = fresh;
+    }
+
+    rsRebuild(rs, first);
+}
+
+// fill the empty store with the lines of buf, whose newlines are at
+// nl[0..n), as rows borrowing their text from it, a leaf at a time rather
+// than a row at a time. Returns the number of rows.
+int rsLines(struct rowStore *rs, const char *buf, size_t len,
+        const size_t *nl, size_t n) {
+    struct rsLeaf *first = NULL, *prev = NULL;
+    size_t lines = n + ((n ? nl[n - 1] + 1 : 0) < len);
+    size_t i = 0, start = 0;
+
+    while (i < lines) {
+        struct rsLeaf *leaf = rsNewLeaf(1);
+        int k;
+        for (k = 0; k < RS_LEAF_MAX && i < lines; k++, i++) {
+            size_t end = i < n ? nl[i] : len;
+            size_t size = end - start;
+            // the same as rsLine, a last line without a newline loses a '\r'
+            if (i == n && size > 0 && buf[end - 1] == '\r') size--;
+            erow *row = &leaf->row[k];
+            row->size = size;
+            row->cap = 0;
+            row->chars = (char *)&buf[start];
+            row->hlin = 0;
+            row->hlend = SYN_STALE;
+            leaf->bytes += size + 1;
+            start = end + 1;
+        }
+        leaf->h.n = k;
+        leaf->prev = prev;
+        if (prev) prev->next = leaf;
+        else first = leaf;
+        prev = leaf;
+    }
+    rsRebuild(rs, first);
+    return lines;
+}
+
+// take rows [at, at + n) out, copying them to out
+void rsDeleteRange(struct rowStore *rs, int at, int n, erow *out) {
+    if (n < RS_LEAF_MAX) {
+        int i;
+        for (i = 0; i < n; i++) {
+            out[i] = *rsGet(rs, at);
+            rsDelete(rs, at);
+        }
+        return;
+    }
+
+    struct rsInner *path[RS_MAXDEPTH];
+    int slot[RS_MAXDEPTH];
+    int depth;
+    int off = at;
+    struct rsLeaf *first = rsFirstLeaf(rs);
+    struct rsLeaf *leaf = rsFind(rs, &off, path, slot, &depth);
+
+    while (n > 0 && leaf) {
+        rsLoad(rs, leaf);
+        int take = leaf->h.n - off < n ? leaf->h.n - off : n;
+        memcpy(out, &leaf->row[off], sizeof(erow) * take);
+        leaf->bytes -= rsLeafBytes(leaf, off, off + take);
+        memmove(&leaf->row[off], &leaf->row[off + take],
+                sizeof(erow) * (leaf->h.n - off - take));
+        leaf->h.n -= take;
+        out += take;
+        n -= take;
+        leaf = leaf->next;
+        off = 0;
+    }
+
+    rsRebuild(rs, first);
+}
+
+/*** backed stores ***/
+// back the (empty) store with the file mapped at base, one leaf on disk
+// per block of lines, keeping up to cache clean leaves loaded
+void rsMap(struct rowStore *rs, const char *base, const struct liBlock *b,
+        size_t n, int cache) {
+    struct rsLeaf *first = NULL, *prev = NULL;
+    size_t i;
+
+    rs->base = base;
+    rs->cache = cache;
+    for (i = 0; i < n; i++) {
+        struct rsLeaf *leaf = rsNewLeaf(0);
+        leaf->h.n = b[i].lines;
+        leaf->off = b[i].off;
+        leaf->len = b[i].len;
+        leaf->bytes = rsExtentBytes(base, leaf->off, leaf->len);
+        leaf->prev = prev;
+        if (prev) prev->next = leaf;
+        else first = leaf;
+        prev = leaf;
+    }
+    rsRebuild(rs, first);
+}
+
+// by 1 before other threads start iterating the store, -1 once they are
+// done, leaves aren't dropped in between
+void rsPin(struct rowStore *rs, int by) {
+    rs->pinned += by;
+}
+
+// drop the least recently used clean leaves back to disk until no more than
+// rs->cache are loaded, edited ones leave the list for good. Rows handed
+// out before this are no longer valid, so it's only called between keys.
+void rsTrim(struct rowStore *rs) {
+    struct rsLeaf *leaf = rs->oldest;
+
+    while (leaf && rs->nloaded > rs->cache && !rs->pinned) {
+        struct rsLeaf *newer = leaf->newer;
+        rsUncache(rs, leaf);
+        if (rsClean(rs, leaf)) {
+            pthread_mutex_lock(&rs->lock);
+            free(leaf->row);
+            leaf->row = NULL;
+            pthread_mutex_unlock(&rs->lock);
+            if (rs->hint == leaf) rs->hint = NULL;
+        } else {
+            leaf->len = 0;
+        }
+        leaf = newer;
+    }
+}
+
+// the rows in order as a malloc'd array of runs, neighbouring lines still
+// on disk merged into one run so a save can copy them in one go. The rows
+// of the rest are only good until the store changes.
+int rsRuns(struct rowStore *rs, struct rsRun **runs) {
+    int n = 0, cap = 64;
+    struct rsRun *r = malloc(sizeof(struct rsRun) * cap);
+    struct rsLeaf *leaf;
+
+    for (leaf = rsFirstLeaf(rs); leaf; leaf = leaf->next) {
+        int disk = leaf->len && (leaf->row == NULL || rsClean(rs, leaf));
+        struct rsRun *last = n ? &r[n - 1] : NULL;
+        if (disk && last && last->rows == NULL
+                && last->off + last->len == leaf->off) {
+            last->len += leaf->len;
+            last->n += leaf->h.n;
+            continue;
+        }
+
+        if (n == cap) {
+            cap *= 2;
+            r = realloc(r, sizeof(struct rsRun) * cap);
+        }
+        r[n].off = disk ? leaf->off : 0;
+        r[n].len = disk ? leaf->len : 0;
+        r[n].nl = 0;
+        r[n].rows = disk ? NULL : leaf->row;
+        r[n].n = leaf->h.n;
+        n++;
+    }
+
+    // only the file's last line can be missing its newline, and the rows
+    // it was read into dropped a '\r' there too (see rsLine)
+    int i;
+    for (i = 0; i < n; i++) {
+        if (r[i].rows || r[i].len == 0) continue;
+        const char *end = rs->base + r[i].off + r[i].len;
+        if (end[-1] == '\n') continue;
+        if (end[-1] == '\r') r[i].len--;
+        r[i].nl = 1;
+    }
+
+    *runs = r;
+    return n;
+}
+
+/*** iteration ***/
+// point it at row i of leaf, reading it from the map if the leaf is on disk
+static erow *rsIterEnter(struct rsIter *it, struct rsLeaf *leaf, int i) {
+    it->leaf = leaf;
+    it->i = i;
+    pthread_mutex_lock(&it->rs->lock);
+    it->row = leaf->row;
+    pthread_mutex_unlock(&it->rs->lock);
+    if (it->row) return &it->row[i];
+
+    const char *p = it->rs->base + leaf->off;
+    const char *end = p + leaf->len;
+    int k;
+    for (k = 0; k <= i; k++)
+        p = rsLine(p, end, &it->peek);
+    it->next = p;
+    return &it->peek;
+}
+
+erow *rsIterStart(struct rsIter *it, struct rowStore *rs, int at) {
+    struct rsInner *path[RS_MAXDEPTH];
+    int slot[RS_MAXDEPTH];
+    int depth;
+    int off = at;
+
+    it->rs = rs;
+    it->leaf = NULL;
+    if (at < 0 || rs->root == NULL) return NULL;
+
+    struct rsLeaf *leaf = rsFind(rs, &off, path, slot, &depth);
+    if (off >= leaf->h.n) return NULL;
+
+    return rsIterEnter(it, leaf, off);
+}
+
+erow *rsIterNext(struct rsIter *it) {
+    if (it->leaf == NULL) return NULL;
+
+    if (++it->i >= it->leaf->h.n) {
+        struct rsLeaf *next = it->leaf->next;
+        it->leaf = NULL;
+        return next ? rsIterEnter(it, next, 0) : NULL;
+    }
+    if (it->row) return &it->row[it->i];
+
+    const char *end = it->rs->base + it->leaf->off + it->leaf->len;
+    it->next = rsLine(it->next, end, &it->peek);
+    return &it->peek;
+}
+
+erow *rsIterPrev(struct rsIter *it) {
+    if (it->leaf == NULL) return NULL;
+
+    if (--it->i < 0) {
+        struct rsLeaf *prev = it->leaf->prev;
+        it->leaf = NULL;
+        return prev ? rsIterEnter(it, prev, prev->h.n - 1) : NULL;
+    }
+    if (it->row) return &it->row[it->i];
+    // lines on disk are only read forwards, so start the leaf over
+    return rsIterEnter(it, it->leaf, it->i);
+}
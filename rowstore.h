@@ -0,0 +1,93 @@
+#ifndef ROWSTORE_H
+#define ROWSTORE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "erow.h"
+#include "lineindex.h"
+
+/*** ROW STORE ***/
+// Rows live in fixed size leaf blocks hung off a counted B+ tree, so finding,
+// inserting or deleting row i is O(log n) and only ever moves the rows of a
+// single leaf. Pointers returned are only valid until the next insert/delete.
+// Moving a run of rows of at least a leaf's worth in or out splices whole
+// leaves into the chain and rebuilds the inner nodes above them, which is a
+// copy of the rows plus a pass over the leaves rather than a tree operation
+// per row.
+//
+// Next to the rows below each child the inner nodes count their bytes, so
+// the offset of row i in the file and the row holding byte x are O(log n)
+// too (rsOffset, rsRowAt). Rows changing size in place have to tell the
+// store with rsResize.
+//
+// A store can also be backed by a mapped file (rsMap), for files too big to
+// hold a row for every line. Its leaves then start out as just the extent
+// of the file their lines are in and only get rows when something looks
+// them up. Leaves whose rows are still exactly those lines are kept on an
+// LRU list and rsTrim drops the oldest ones back to their extent, while
+// leaves that were edited stay in memory as an overlay on the file.
+// Iterating never loads a leaf, rows of a leaf on disk are read straight
+// out of the map one at a time, so a search thread can walk the lot.
+#define RS_LEAF_MAX 512
+#define RS_FANOUT 64
+#define RS_MAXDEPTH 16
+
+struct rsNode;
+struct rsLeaf;
+
+struct rowStore {
+    struct rsNode *root;
+    // last leaf looked up, makes walking rows in order O(1) per row
+    struct rsLeaf *hint;
+    int hintstart;
+    // the rest is only used once the store is backed by a file
+    const char *base;
+    int cache;   // clean leaves rsTrim leaves loaded
+    int nloaded;
+    int pinned;  // other threads iterating, no leaf may be dropped
+    struct rsLeaf *newest, *oldest;
+    pthread_mutex_t lock; // guards leaf rows against iterating threads
+};
+
+struct rsIter {
+    struct rowStore *rs;
+    struct rsLeaf *leaf;
+    erow *row; // the leaf's rows, NULL while they are only on disk
+    int i;
+    erow peek;         // row i read from the map in that case
+    const char *next;  // and where the one after it starts
+};
+
+// the rows in order, either as lines still untouched in the backing file
+// or as rows held in memory, see rsRuns
+struct rsRun {
+    size_t off, len; // bytes of the file when rows is NULL
+    int nl;          // whether they still want a newline after them
+    const erow *rows;
+    int n;           // rows in the run
+};
+
+void rsInit(struct rowStore *rs);
+void rsFree(struct rowStore *rs);
+erow *rsGet(struct rowStore *rs, int at);
+erow *rsInsert(struct rowStore *rs, int at);
+void rsDelete(struct rowStore *rs, int at);
+void rsInsertRange(struct rowStore *rs, int at, const erow *rows, int n);
+void rsDeleteRange(struct rowStore *rs, int at, int n, erow *out);
+int rsLines(struct rowStore *rs, const char *buf, size_t len,
+        const size_t *nl, size_t n);
+void rsResize(struct rowStore *rs, int at, int delta);
+size_t rsOffset(struct rowStore *rs, int at);
+int rsRowAt(struct rowStore *rs, size_t pos, size_t *start);
+
+void rsMap(struct rowStore *rs, const char *base, const struct liBlock *b,
+        size_t n, int cache);
+void rsPin(struct rowStore *rs, int by);
+void rsTrim(struct rowStore *rs);
+int rsRuns(struct rowStore *rs, struct rsRun **runs);
+
+erow *rsIterStart(struct rsIter *it, struct rowStore *rs, int at);
+erow *rsIterNext(struct rsIter *it);
+erow *rsIterPrev(struct rsIter *it);
+#endif
@@ -0,0 +1,238 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "save.h"
+
+void svInit(struct saveJob *job) {
+    job->filename = NULL;
+    job->rows = NULL;
+    job->nrows = 0;
+    job->pieces = NULL;
+    job->npieces = 0;
+    job->src = -1;
+    job->dirty = 0;
+    job->active = 0;
+    job->threaded = 0;
+    job->total = job->written = 0;
+    job->done = 0;
+    job->err = 0;
+    pthread_mutex_init(&job->lock, NULL);
+}
+
+// a job that is no longer active, see svWait
+void svFree(struct saveJob *job) {
+    free(job->filename);
+    job->filename = NULL;
+    pthread_mutex_destroy(&job->lock);
+}
+
+// writev the whole of iov, carrying on after short writes
+static int svWriteAll(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt);
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+static void svWritten(struct saveJob *job, size_t bytes) {
+    pthread_mutex_lock(&job->lock);
+    job->written += bytes;
+    pthread_mutex_unlock(&job->lock);
+}
+
+// rows [first, end) of the snapshot, each followed by a newline
+static int svRows(struct saveJob *job, int fd, int first, int end) {
+    struct iovec iov[SV_BATCH * 2];
+    int i = first;
+
+    while (i < end) {
+        int cnt = 0;
+        size_t bytes = 0;
+        for (; i < end && cnt < SV_BATCH * 2; i++) {
+            iov[cnt].iov_base = job->rows[i].chars;
+            iov[cnt].iov_len = job->rows[i].size;
+            iov[cnt + 1].iov_base = "\n";
+            iov[cnt + 1].iov_len = 1;
+            bytes += job->rows[i].size + 1;
+            cnt += 2;
+        }
+        if (svWriteAll(fd, iov, cnt) == -1) return -1;
+        svWritten(job, bytes);
+    }
+    return 0;
+}
+
+// len bytes of the source file from off, copied inside the kernel
+static int svCopy(struct saveJob *job, int fd, size_t off, size_t len) {
+    loff_t from = off;
+    int usecfr = 1;
+
+    while (len > 0) {
+        size_t want = len < SV_COPY_MAX ? len : SV_COPY_MAX;
+        ssize_t n;
+        if (usecfr) {
+            n = copy_file_range(job->src, &from, fd, NULL, want, 0);
+            // not across filesystems on older kernels, sendfile still
+            // splices the pages over without a copy through userspace
+            if (n == -1 && (errno == EXDEV || errno == ENOSYS
+                        || errno == EINVAL || errno == EOPNOTSUPP)) {
+                usecfr = 0;
+                continue;
+            }
+        } else {
+            off_t pos = from;
+            n = sendfile(fd, job->src, &pos, want);
+            if (n > 0) from = pos;
+        }
+        if (n == -1) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) {
+            // the file got shorter under us
+            errno = EIO;
+            return -1;
+        }
+        len -= n;
+        svWritten(job, n);
+    }
+    return 0;
+}
+
+static int svStream(struct saveJob *job, int fd) {
+    if (job->pieces == NULL) return svRows(job, fd, 0, job->nrows);
+
+    int i;
+    for (i = 0; i < job->npieces; i++) {
+        struct svPiece *p = &job->pieces[i];
+        if (p->n) {
+            if (svRows(job, fd, p->first, p->first + p->n) == -1) return -1;
+            continue;
+        }
+        if (svCopy(job, fd, p->off, p->len) == -1) return -1;
+        if (p->nl) {
+            struct iovec iov = { "\n", 1 };
+            if (svWriteAll(fd, &iov, 1) == -1) return -1;
+            svWritten(job, 1);
+        }
+    }
+    return 0;
+}
+
+// write the snapshot out, returns -1 with job->err set on failure
+int svWrite(struct saveJob *job) {
+    // follow symlinks so we replace the file and not the link
+    char *target = realpath(job->filename, NULL);
+    if (target == NULL) target = strdup(job->filename);
+
+    char *dircopy = strdup(target);
+    char *basecopy = strdup(target);
+    char *dir = dirname(dircopy);
+    char *base = basename(basecopy);
+
+    size_t tmplen = strlen(dir) + strlen(base) + 16;
+    char *tmpname = malloc(tmplen);
+    snprintf(tmpname, tmplen, "%s/.%s.envyXXXXXX", dir, base);
+
+    int err = 0;
+    int fd = mkstemp(tmpname);
+    if (fd == -1) {
+        err = errno;
+    } else {
+        struct stat st;
+        if (stat(target, &st) == 0) {
+            fchmod(fd, st.st_mode & 07777);
+            if (fchown(fd, st.st_uid, st.st_gid) == -1) {
+                // not fatal, we just end up owning the file
+            }
+        } else {
+            fchmod(fd, 0644);
+        }
+
+        if (svStream(job, fd) == -1 || fsync(fd) == -1)
+            err = errno;
+        if (close(fd) == -1 && !err)
+            err = errno;
+        if (!err && rename(tmpname, target) == -1)
+            err = errno;
+        if (err)
+            unlink(tmpname);
+    }
+
+    if (!err) {
+        // make the rename itself durable
+        int dfd = open(dir, O_RDONLY);
+        if (dfd != -1) {
+            fsync(dfd);
+            close(dfd);
+        }
+    }
+
+    free(tmpname);
+    free(basecopy);
+    free(dircopy);
+    free(target);
+
+    pthread_mutex_lock(&job->lock);
+    job->err = err;
+    job->done = 1;
+    pthread_mutex_unlock(&job->lock);
+    return err ? -1 : 0;
+}
+
+static void *svThread(void *arg) {
+    svWrite(arg);
+    return NULL;
+}
+
+// run svWrite on its own thread, falls back to writing here and now
+int svStart(struct saveJob *job) {
+    job->active = 1;
+    job->threaded = pthread_create(&job->tid, NULL, svThread, job) == 0;
+    if (!job->threaded) return svWrite(job);
+    return 0;
+}
+
+int svDone(struct saveJob *job) {
+    pthread_mutex_lock(&job->lock);
+    int done = job->done;
+    pthread_mutex_unlock(&job->lock);
+    return done;
+}
+
+// wait for the writer, the job's result is then safe to read
+void svWait(struct saveJob *job) {
+    if (job->threaded) pthread_join(job->tid, NULL);
+    job->threaded = 0;
+}
+
+// percentage written so far
+int svProgress(struct saveJob *job) {
+    pthread_mutex_lock(&job->lock);
+    int pct = job->total ? (int)(job->written * 100 / job->total) : 100;
+    pthread_mutex_unlock(&job->lock);
+    return pct;
+}
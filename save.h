@@ -0,0 +1,54 @@
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "erow.h"
+
+/*** SAVE ***/
+// Saves stream a snapshot of the rows into a temp file next to the target
+// with writev, fsync it and rename it over the original, so a crash part
+// way through leaves the old file untouched. Big files are written from a
+// thread while the editor carries on.
+//
+// A file opened out of core saves as pieces instead: runs of snapshot rows
+// for what was edited, and ranges of the original file for the rest, which
+// are copied across with copy_file_range (or sendfile) without passing
+// through userspace.
+#define SV_BATCH 512 // rows per writev, two iovecs each
+#define SV_COPY_MAX (1 << 30) // bytes per copy_file_range
+
+struct svPiece {
+    size_t off, len; // bytes of the source file, when n is 0
+    int nl;          // with a newline to follow them
+    int first, n;    // or rows [first, first + n) of the snapshot
+};
+
+struct saveJob {
+    char *filename;
+    erow *rows;   // snapshot, each row holding a reference to its text
+    int nrows;
+    struct svPiece *pieces; // NULL to just write the rows in order
+    int npieces;
+    int src;      // the file the pieces copy from
+    int dirty;    // E->dirty when the snapshot was taken
+    int active;   // a job has been started and not yet finished off
+    int threaded;
+    pthread_t tid;
+    pthread_mutex_t lock;
+    // the fields below are shared with the writer thread, use the lock
+    size_t total;
+    size_t written;
+    int done;
+    int err; // errno of whatever failed, 0 on success
+};
+
+void svInit(struct saveJob *job);
+void svFree(struct saveJob *job);
+int svWrite(struct saveJob *job);
+int svStart(struct saveJob *job);
+int svDone(struct saveJob *job);
+void svWait(struct saveJob *job);
+int svProgress(struct saveJob *job);
+#endif
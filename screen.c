@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "screen.h"
+#include "utf8.h"
+
+#define SCR_SAME(a, b) ((a).len == (b).len && (a).attr == (b).attr \
+        && memcmp((a).ch, (b).ch, (a).len) == 0)
+#define SCR_SPACE(c) ((c).len == 1 && (c).ch[0] == ' ')
+#define SCR_BLANK(c) (SCR_SPACE(c) && (c).attr == 0)
+
+static void scrBlank(struct scell *c, int n) {
+    while (n--) {
+        c->ch[0] = ' ';
+        c->len = 1;
+        c->attr = 0;
+        c++;
+    }
+}
+
+void scrInit(struct screen *s) {
+    s->rows = s->cols = 0;
+    s->cur = s->prev = NULL;
+    s->synced = 0;
+}
+
+void scrFree(struct screen *s) {
+    free(s->cur);
+    free(s->prev);
+    scrInit(s);
+}
+
+void scrResize(struct screen *s, int rows, int cols) {
+    if (rows == s->rows && cols == s->cols) return;
+
+    s->rows = rows;
+    s->cols = cols;
+    s->cur = realloc(s->cur, sizeof(struct scell) * rows * cols);
+    s->prev = realloc(s->prev, sizeof(struct scell) * rows * cols);
+    scrBlank(s->cur, rows * cols);
+    s->synced = 0;
+}
+
+void scrClear(struct screen *s) {
+    scrBlank(s->cur, s->rows * s->cols);
+}
+
+// write UTF-8 text at column x of row y clipped to the screen, returns the
+// column after it
+int scrPut(struct screen *s, int y, int x, const char *text, int len,
+        unsigned char attr) {
+    if (y < 0 || y >= s->rows) return x;
+    struct scell *c = &s->cur[y * s->cols];
+    int i = 0;
+    while (i < len && x < s->cols) {
+        if ((unsigned char)text[i] < 0x80) {
+            c[x].ch[0] = text[i++];
+            c[x].len = 1;
+            c[x].attr = attr;
+            x++;
+            continue;
+        }
+
+        int cp;
+        int n = u8Decode(&text[i], len - i, &cp);
+        int w = u8Width(cp);
+        if (w == 0) {
+            // combining marks go on the character before them
+            struct scell *prev = x > 0 ? &c[x - 1] : NULL;
+            if (prev && prev->len == 0 && x > 1) prev = &c[x - 2];
+            if (prev && prev->len + n <= (int)sizeof(prev->ch)) {
+                memcpy(&prev->ch[prev->len], &text[i], n);
+                prev->len += n;
+            }
+        } else if (w == 2 && x + 1 >= s->cols) {
+            // half a wide character won't do
+            c[x].ch[0] = ' ';
+            c[x].len = 1;
+            c[x].attr = attr;
+            x++;
+        } else {
+            memcpy(c[x].ch, &text[i], n);
+            c[x].len = n;
+            c[x].attr = attr;
+            x++;
+            if (w == 2) {
+                c[x].len = 0;
+                c[x].attr = attr;
+                x++;
+            }
+        }
+        i += n;
+    }
+    return x;
+}
+
+int scrFill(struct screen *s, int y, int x, char ch, int n, unsigned char attr) {
+    if (y < 0 || y >= s->rows) return x;
+    struct scell *c = &s->cur[y * s->cols];
+    while (n-- > 0 && x < s->cols) {
+        c[x].ch[0] = ch;
+        c[x].len = 1;
+        c[x].attr = attr;
+        x++;
+    }
+    return x;
+}
+
+static void scrAttr(struct abuf *ab, unsigned char attr) {
+    abAppend(ab, "\x1b[m", 3);
+    if (attr & SCR_REVERSE) abAppend(ab, "\x1b[7m", 4);
+    if (attr & SCR_FG) abPrintf(ab, "\x1b[%dm", 30 + (attr & SCR_FG) - 1);
+}
+
+// append the escape sequences turning the terminal's copy of the screen
+// into the one just drawn, then make that the new baseline
+void scrFlush(struct screen *s, struct abuf *ab) {
+    int attr = -1;
+    int y;
+
+    if (!s->synced) {
+        abAppend(ab, "\x1b[m\x1b[2J", 7);
+        scrBlank(s->prev, s->rows * s->cols);
+        attr = 0;
+        s->synced = 1;
+    }
+
+    for (y = 0; y < s->rows; y++) {
+        struct scell *c = &s->cur[y * s->cols];
+        struct scell *p = &s->prev[y * s->cols];
+
+        // everything from tail on is blank, which one erase can cover
+        int tail = s->cols;
+        while (tail > 0 && SCR_BLANK(c[tail - 1])) tail--;
+
+        int x = 0;
+        while (x < s->cols) {
+            if (SCR_SAME(c[x], p[x])) {
+                x++;
+                continue;
+            }
+            // the right half of a wide character is drawn by its left half
+            if (c[x].len == 0 && x > 0) x--;
+
+            int end = x + 1;
+            int k = end;
+            while (k < s->cols) {
+                if (!SCR_SAME(c[k], p[k])) {
+                    end = ++k;
+                    continue;
+                }
+                int gap = k;
+                while (gap < s->cols && SCR_SAME(c[gap], p[gap])) gap++;
+                if (gap == s->cols || gap - k > SCR_GAP) break;
+                k = gap;
+            }
+
+            abPrintf(ab, "\x1b[%d;%dH", y + 1, x + 1);
+
+            while (x < end && x < tail) {
+                if (c[x].attr != attr) {
+                    attr = c[x].attr;
+                    scrAttr(ab, attr);
+                }
+                // indentation and the like go out as one run of spaces
+                int run = 0;
+                while (x + run < end && x + run < tail
+                        && SCR_SPACE(c[x + run]) && c[x + run].attr == attr)
+                    run++;
+                if (run > 0) {
+                    abFill(ab, ' ', run);
+                    x += run;
+                    continue;
+                }
+                abAppend(ab, c[x].ch, c[x].len);
+                x++;
+            }
+            if (x < end) {
+                if (attr != 0) {
+                    attr = 0;
+                    scrAttr(ab, attr);
+                }
+                abAppend(ab, "\x1b[K", 3);
+                break;
+            }
+        }
+    }
+    if (attr != 0 && attr != -1) scrAttr(ab, 0);
+
+    memcpy(s->prev, s->cur, sizeof(struct scell) * s->rows * s->cols);
+}
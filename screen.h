@@ -0,0 +1,38 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include "buffer.h"
+
+/*** SCREEN ***/
+// Frames are drawn into a grid of cells, then compared against the grid we
+// sent last time so only the cells that changed go out to the terminal.
+#define SCR_REVERSE 0x80
+#define SCR_FG 0x0f // foreground colour + 1 (31 red is 2), 0 for the default
+// unchanged cells between two changed ones we reprint rather than paying
+// for another cursor move
+#define SCR_GAP 6
+
+// a cell holds one UTF-8 character plus any combining marks that fit, the
+// cell to the right of a wide character is left empty (len 0)
+struct scell {
+    char ch[6];
+    unsigned char len;
+    unsigned char attr;
+};
+
+struct screen {
+    int rows, cols;
+    struct scell *cur;  // frame being drawn
+    struct scell *prev; // what the terminal is showing
+    int synced;         // 0 until the terminal has been cleared to match prev
+};
+
+void scrInit(struct screen *s);
+void scrFree(struct screen *s);
+void scrResize(struct screen *s, int rows, int cols);
+void scrClear(struct screen *s);
+int scrPut(struct screen *s, int y, int x, const char *text, int len,
+        unsigned char attr);
+int scrFill(struct screen *s, int y, int x, char c, int n, unsigned char attr);
+void scrFlush(struct screen *s, struct abuf *ab);
+#endif
@@ -0,0 +1,359 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "editorconfig.h"
+#include "terminal.h"
+#include "row.h"
+#include "search.h"
+#include "regex.h"
+
+void srchInit(struct search *s) {
+    s->query = NULL;
+    s->qlen = 0;
+    s->re = NULL;
+    s->gen = 0;
+    s->match = NULL;
+    s->nmatch = s->cap = 0;
+    s->check = s->keep = 0;
+    s->done = 0;
+    s->origin = 0;
+    s->cur = -1;
+    s->rows = NULL;
+    s->chunk = NULL;
+    s->nchunk = s->first = 0;
+    s->active = 0;
+    s->nthreads = 0;
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    s->claimed = s->finished = s->found = 0;
+    s->cancel = 0;
+}
+
+static void srchPush(int **match, int *n, int *cap, int row) {
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        *match = realloc(*match, sizeof(int) * *cap);
+    }
+    (*match)[(*n)++] = row;
+}
+
+// matches that can be stepped through right now
+static int srchReady(struct search *s) {
+    return s->check < s->nmatch ? s->keep : s->nmatch;
+}
+
+/*** worker pool ***/
+static void *srchWorker(void *arg) {
+    struct search *s = arg;
+    // each worker needs its own DFA cache
+    struct regex *re = reClone(s->re);
+
+    while (1) {
+        pthread_mutex_lock(&s->lock);
+        int k = (s->claimed < s->nchunk && !s->cancel) ? s->claimed++ : -1;
+        pthread_mutex_unlock(&s->lock);
+        if (k < 0) break;
+
+        struct srchChunk *c = &s->chunk[(s->first + k) % s->nchunk];
+        struct rsIter it;
+        int at = c->start;
+        erow *row = re ? rsIterStart(&it, s->rows, at) : NULL;
+        for (; row && at < c->end; row = rsIterNext(&it), at++) {
+            int start, end;
+            if (reSearch(re, row->chars, row->size, 0, &start, &end))
+                srchPush(&c->match, &c->nmatch, &c->cap, at);
+        }
+
+        pthread_mutex_lock(&s->lock);
+        c->done = 1;
+        s->finished++;
+        s->found += c->nmatch;
+        pthread_cond_broadcast(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    reFree(re);
+    return NULL;
+}
+
+// hand every row to the workers, starting with the chunk holding the origin
+static void srchScan(struct search *s, struct editorConfig *E) {
+    int nchunk = (E->numrows + SRCH_CHUNK - 1) / SRCH_CHUNK;
+    s->nmatch = s->check = s->keep = 0;
+    if (nchunk == 0) {
+        s->done = 1;
+        return;
+    }
+
+    s->chunk = calloc(nchunk, sizeof(struct srchChunk));
+    int i;
+    for (i = 0; i < nchunk; i++) {
+        s->chunk[i].start = i * SRCH_CHUNK;
+        s->chunk[i].end = i == nchunk - 1 ? E->numrows : (i + 1) * SRCH_CHUNK;
+    }
+    s->nchunk = nchunk;
+    s->rows = &E->rows;
+    s->first = s->origin < 0 || s->origin >= E->numrows
+        ? 0 : s->origin / SRCH_CHUNK;
+    rsPin(s->rows, 1);
+    s->claimed = s->finished = s->found = 0;
+    s->cancel = 0;
+    s->active = 1;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    int want = ncpu > SRCH_MAX_THREADS ? SRCH_MAX_THREADS : ncpu > 1 ? ncpu : 1;
+    if (want > nchunk) want = nchunk;
+
+    s->nthreads = 0;
+    while (s->nthreads < want
+            && pthread_create(&s->tid[s->nthreads], NULL, srchWorker, s) == 0)
+        s->nthreads++;
+    if (s->nthreads == 0) srchWorker(s);
+}
+
+static void srchJoin(struct search *s) {
+    int t;
+    for (t = 0; t < s->nthreads; t++)
+        pthread_join(s->tid[t], NULL);
+    s->nthreads = 0;
+    rsPin(s->rows, -1);
+    s->active = 0;
+}
+
+// once every chunk is in, gather them into the match list, returns s->done
+int srchPoll(struct search *s) {
+    if (!s->active) return s->done;
+
+    pthread_mutex_lock(&s->lock);
+    int finished = s->finished == s->nchunk;
+    pthread_mutex_unlock(&s->lock);
+    if (!finished) return 0;
+
+    srchJoin(s);
+    if (s->cap < s->found) {
+        s->cap = s->found;
+        s->match = realloc(s->match, sizeof(int) * s->cap);
+    }
+    int i;
+    s->nmatch = 0;
+    for (i = 0; i < s->nchunk; i++) {
+        struct srchChunk *c = &s->chunk[i];
+        memcpy(&s->match[s->nmatch], c->match, sizeof(int) * c->nmatch);
+        s->nmatch += c->nmatch;
+        free(c->match);
+    }
+    free(s->chunk);
+    s->chunk = NULL;
+    s->nchunk = 0;
+    s->check = s->keep = s->nmatch;
+    s->done = 1;
+    return 1;
+}
+
+// block until a scan under way is done, then gather it up like srchPoll
+void srchWait(struct search *s) {
+    if (!s->active) return;
+
+    pthread_mutex_lock(&s->lock);
+    while (s->finished < s->nchunk)
+        pthread_cond_wait(&s->cond, &s->lock);
+    pthread_mutex_unlock(&s->lock);
+    srchPoll(s);
+}
+
+// cancel a scan and forget the query, the rows are about to change
+void srchStop(struct search *s) {
+    s->cur = -1;
+    if (!s->active) return;
+
+    pthread_mutex_lock(&s->lock);
+    s->cancel = 1;
+    pthread_mutex_unlock(&s->lock);
+    srchJoin(s);
+
+    int i;
+    for (i = 0; i < s->nchunk; i++)
+        free(s->chunk[i].match);
+    free(s->chunk);
+    s->chunk = NULL;
+    s->nchunk = 0;
+    s->nmatch = s->check = s->keep = 0;
+    s->done = 0;
+    free(s->query);
+    s->query = NULL;
+}
+
+// stop any scan and free the lot
+void srchFree(struct search *s) {
+    srchStop(s);
+    free(s->query);
+    reFree(s->re);
+    free(s->match);
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+}
+
+// Bring the match list up to date with query, returns 1 once every row has
+// been looked at and 0 while that is still going on, either in the workers
+// or because a re-test gave up early for a key that is waiting.
+int srchRun(struct search *s, const char *query, int interruptible,
+        struct editorConfig *E) {
+    int qlen = strlen(query);
+    eGapClose(E);
+
+    if (s->query == NULL || s->gen != E->rgen || strcmp(query, s->query) != 0) {
+        // a longer regex can match rows the shorter one didn't ("ab" -> "ab|c"),
+        // and "" has an empty match list rather than every row in it
+        int literal = strpbrk(query, ".[]()*+?|^$\\") == NULL;
+        int narrow = s->query && s->qlen > 0 && !s->active
+            && s->gen == E->rgen && qlen > s->qlen && literal
+            && s->re && s->re->literal
+            && strncmp(query, s->query, s->qlen) == 0;
+
+        srchStop(s);
+        if (narrow) {
+            // close the hole an interrupted re-test left, then every match
+            // so far is a candidate for the longer query
+            memmove(&s->match[s->keep], &s->match[s->check],
+                    sizeof(int) * (s->nmatch - s->check));
+            s->nmatch -= s->check - s->keep;
+            s->check = s->keep = 0;
+        }
+
+        free(s->query);
+        s->query = strdup(query);
+        s->qlen = qlen;
+        reFree(s->re);
+        s->re = reCompile(query);
+        s->gen = E->rgen;
+        s->done = 0;
+
+        if (qlen == 0 || s->re == NULL) {
+            s->nmatch = s->check = s->keep = 0;
+            s->done = 1;
+            return 1;
+        }
+        if (!narrow) {
+            srchScan(s, E);
+            return srchPoll(s);
+        }
+    }
+
+    if (s->active) return srchPoll(s);
+    if (s->done) return 1;
+
+    int n = 0;
+    while (s->check < s->nmatch) {
+        erow *row = rsGet(&E->rows, s->match[s->check]);
+        if (srchCol(s, row->chars, row->size) >= 0)
+            s->match[s->keep++] = s->match[s->check];
+        s->check++;
+        if (interruptible && ++n % SRCH_CHUNK == 0 && eInputPending(E))
+            return 0;
+    }
+    s->nmatch = s->check = s->keep;
+
+    s->done = 1;
+    return 1;
+}
+
+// column the query first matches at in chars, -1 if it doesn't
+int srchCol(struct search *s, const char *chars, int size) {
+    int start, end;
+    if (s->re == NULL || !reSearch(s->re, chars, size, 0, &start, &end))
+        return -1;
+    return start;
+}
+
+// first match in rows past from (dir 1) or before it (dir -1), or with
+// from < 0 the first in that direction
+static int srchPick(int *match, int n, int from, int dir) {
+    if (n == 0) return -1;
+    if (from < 0) return dir > 0 ? match[0] : match[n - 1];
+
+    int lo = 0, hi = n;
+    int past = dir > 0 ? from + 1 : from;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (match[mid] < past) lo = mid + 1;
+        else hi = mid;
+    }
+    if (dir > 0) return lo < n ? match[lo] : -1;
+    return lo > 0 ? match[lo - 1] : -1;
+}
+
+// Row of the next match after (dir 1) or before (dir -1) row from, wrapping
+// around the ends, -1 if there are none. While the workers are still busy
+// that is only known once the chunks between here and there are done, so
+// either wait for them or return -1 and let the caller try again later.
+int srchNearest(struct search *s, int from, int dir, int wait) {
+    srchPoll(s);
+
+    if (!s->active) {
+        int ready = srchReady(s);
+        int row = srchPick(s->match, ready, from, dir);
+        return row >= 0 ? row : srchPick(s->match, ready, -1, dir);
+    }
+
+    pthread_mutex_lock(&s->lock);
+    int n = s->nchunk;
+    int c = from < 0 ? 0 : from / SRCH_CHUNK;
+    if (c >= n) c = n - 1;
+
+    int k = 0, row = -1;
+    while (k <= n) {
+        struct srchChunk *ch = &s->chunk[((c + dir * k) % n + n) % n];
+        if (!ch->done) {
+            if (!wait) break;
+            pthread_cond_wait(&s->cond, &s->lock);
+            continue;
+        }
+        row = srchPick(ch->match, ch->nmatch, k == 0 ? from : -1, dir);
+        if (row >= 0) break;
+        k++;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return row;
+}
+
+// 1 based position of row among the matches, 0 if that isn't known (yet)
+int srchIndex(struct search *s, int row) {
+    int *match = s->match;
+    int n = srchReady(s);
+    int before = 0;
+
+    if (s->active) {
+        pthread_mutex_lock(&s->lock);
+        int c = row / SRCH_CHUNK, i;
+        for (i = 0; i < c && i < s->nchunk && s->chunk[i].done; i++)
+            before += s->chunk[i].nmatch;
+        int known = i == c && c < s->nchunk && s->chunk[c].done;
+        if (known) {
+            match = s->chunk[c].match;
+            n = s->chunk[c].nmatch;
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (!known) return 0;
+    }
+
+    int lo = 0, hi = n;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (match[mid] < row) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo < n && match[lo] == row ? before + lo + 1 : 0;
+}
+
+// matches found so far, all of them unless s->active
+int srchCount(struct search *s) {
+    if (!s->active) return srchReady(s);
+
+    pthread_mutex_lock(&s->lock);
+    int found = s->found;
+    pthread_mutex_unlock(&s->lock);
+    return found;
+}
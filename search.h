@@ -0,0 +1,71 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <pthread.h>
+
+/*** SEARCH ***/
+// Queries are regular expressions (see regex.h). Matches for the last query
+// are kept as a sorted list of rows. A fresh query is scanned by a pool of
+// worker threads, each taking SRCH_CHUNK rows at a time starting from the
+// cursor, so the match nearest the cursor is usually known long before the
+// whole count is. When a plain string query only grows, the earlier matches
+// are the only rows that can still match, so just those get checked again
+// on the UI thread; that stops whenever a key is waiting and picks up where
+// it was next time.
+#define SRCH_CHUNK 4096        // rows per unit of work, and between checks
+                               // for pending input when re-testing
+#define SRCH_MAX_THREADS 16
+
+struct editorConfig;
+struct rowStore;
+struct regex;
+
+struct srchChunk {
+    int start, end;     // rows
+    int *match;         // owned by the worker until done is set
+    int nmatch, cap;
+    int done;
+};
+
+struct search {
+    char *query;
+    int qlen;
+    struct regex *re; // the compiled query, NULL if it doesn't parse
+    unsigned gen;   // E->rgen the matches were found against
+    int *match;     // rows holding the query, in order
+    int nmatch, cap;
+    int check;      // match[check..nmatch) still to be tested again
+    int keep;       // match[0..keep) passed that test
+    int done;       // match list complete
+    int origin;     // row the find started from
+    int cur;        // match the cursor was last put on, -1 for none
+
+    // a full scan in progress, chunks are handed out from first onwards
+    struct rowStore *rows;
+    struct srchChunk *chunk;
+    int nchunk;
+    int first;
+    int active;
+    int nthreads;
+    pthread_t tid[SRCH_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    // the fields below are shared with the workers, use the lock
+    int claimed;    // chunks handed out
+    int finished;   // chunks done
+    int found;      // matches in finished chunks
+    int cancel;
+};
+
+void srchInit(struct search *s);
+int srchRun(struct search *s, const char *query, int interruptible,
+        struct editorConfig *E);
+int srchPoll(struct search *s);
+void srchWait(struct search *s);
+void srchStop(struct search *s);
+void srchFree(struct search *s);
+int srchNearest(struct search *s, int from, int dir, int wait);
+int srchIndex(struct search *s, int row);
+int srchCount(struct search *s);
+int srchCol(struct search *s, const char *chars, int size);
+#endif
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "editorconfig.h"
+#include "syntax.h"
+#include "row.h"
+
+static const char *cExtensions[] = { ".c", ".h", ".cpp", ".cc", ".hpp", NULL };
+static const char *cKeywords[] = {
+    "switch", "if", "while", "for", "break", "continue", "return", "else",
+    "struct", "union", "typedef", "static", "enum", "class", "case",
+    "default", "do", "goto", "sizeof", "extern", "const", "volatile",
+    "register", "inline", "#include", "#define", "#ifdef", "#ifndef",
+    "#endif", "#if", "#else", "#elif", "#undef", "#pragma",
+
+    "int|", "long|", "double|", "float|", "char|", "unsigned|", "signed|",
+    "void|", "short|", "auto|", "size_t|", "ssize_t|", NULL
+};
+
+static struct syntax synDb[] = {
+    {
+        "c",
+        cExtensions,
+        cKeywords,
+        "//", "/*", "*/",
+        SYN_HL_NUMBERS | SYN_HL_STRINGS,
+        { 0 }
+    },
+};
+
+#define SYN_DB_ENTRIES (sizeof(synDb) / sizeof(synDb[0]))
+
+// the stop tables, filled in once as every editor shares synDb
+static pthread_once_t synOnce = PTHREAD_ONCE_INIT;
+
+static void synBuild(void) {
+    unsigned j;
+    for (j = 0; j < SYN_DB_ENTRIES; j++) {
+        struct syntax *syn = &synDb[j];
+        memset(syn->stop, 0, sizeof(syn->stop));
+        if (syn->comment) syn->stop[(unsigned char)syn->comment[0]] = 1;
+        if (syn->mlstart) syn->stop[(unsigned char)syn->mlstart[0]] = 1;
+        if (syn->flags & SYN_HL_STRINGS) syn->stop['"'] = syn->stop['\''] = 1;
+    }
+}
+
+// syntax to use for filename going by its extension, NULL for none
+struct syntax *synSelect(const char *filename) {
+    if (filename == NULL) return NULL;
+    const char *ext = strrchr(filename, '.');
+    if (ext == NULL) return NULL;
+
+    pthread_once(&synOnce, synBuild);
+    unsigned j;
+    for (j = 0; j < SYN_DB_ENTRIES; j++) {
+        struct syntax *syn = &synDb[j];
+        const char **m;
+        for (m = syn->filematch; *m; m++)
+            if (strcmp(ext, *m) == 0) break;
+        if (*m != NULL) return syn;
+    }
+    return NULL;
+}
+
+static int synSeparator(int c) {
+    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+#define SYN_MARK(i, n, v) do { if (hl) memset(&hl[i], (v), (n)); } while (0)
+
+// Lex one row of text starting in state, filling hl with a class per byte
+// when it isn't NULL, and return the state the row ends in. Without hl only
+// what can carry over to the next row is tracked.
+int synLex(struct syntax *syn, const char *text, int len, int state,
+        unsigned char *hl) {
+    int cslen = syn->comment ? strlen(syn->comment) : 0;
+    int mslen = syn->mlstart ? strlen(syn->mlstart) : 0;
+    int melen = syn->mlend ? strlen(syn->mlend) : 0;
+
+    int sep = 1;       // the previous byte ended a word
+    int prev = HL_NORMAL;
+    int instring = 0;
+    int incomment = state == SYN_COMMENT;
+    int i = 0;
+
+    while (i < len) {
+        // only lexing for the state, skip to the next byte that matters
+        if (hl == NULL && !instring) {
+            if (incomment) {
+                const char *end = memmem(&text[i], len - i, syn->mlend, melen);
+                if (end == NULL) break;
+                i = end - text + melen;
+                incomment = 0;
+                continue;
+            }
+            while (i < len && !syn->stop[(unsigned char)text[i]]) i++;
+            if (i == len) break;
+        }
+        unsigned char c = text[i];
+
+        if (cslen && !instring && !incomment
+                && len - i >= cslen && !strncmp(&text[i], syn->comment, cslen)) {
+            SYN_MARK(i, len - i, HL_COMMENT);
+            break;
+        }
+
+        if (mslen && melen && !instring) {
+            if (incomment) {
+                if (len - i >= melen && !strncmp(&text[i], syn->mlend, melen)) {
+                    SYN_MARK(i, melen, HL_MLCOMMENT);
+                    i += melen;
+                    incomment = 0;
+                    sep = 1;
+                    prev = HL_MLCOMMENT;
+                } else {
+                    SYN_MARK(i, 1, HL_MLCOMMENT);
+                    i++;
+                }
+                continue;
+            } else if (len - i >= mslen
+                    && !strncmp(&text[i], syn->mlstart, mslen)) {
+                SYN_MARK(i, mslen, HL_MLCOMMENT);
+                i += mslen;
+                incomment = 1;
+                continue;
+            }
+        }
+
+        if (syn->flags & SYN_HL_STRINGS) {
+            if (instring) {
+                SYN_MARK(i, 1, HL_STRING);
+                if (c == '\\' && i + 1 < len) {
+                    SYN_MARK(i + 1, 1, HL_STRING);
+                    i += 2;
+                    continue;
+                }
+                if (c == instring) instring = 0;
+                i++;
+                sep = 1;
+                prev = HL_STRING;
+                continue;
+            } else if (c == '"' || c == '\'') {
+                instring = c;
+                SYN_MARK(i, 1, HL_STRING);
+                i++;
+                continue;
+            }
+        }
+
+        // the rest only colours the row, it can't change the state
+        if (hl == NULL) {
+            i++;
+            continue;
+        }
+
+        if (syn->flags & SYN_HL_NUMBERS) {
+            if ((isdigit(c) && (sep || prev == HL_NUMBER))
+                    || (c == '.' && prev == HL_NUMBER)) {
+                hl[i] = prev = HL_NUMBER;
+                i++;
+                sep = 0;
+                continue;
+            }
+        }
+
+        if (sep) {
+            const char **k;
+            for (k = syn->keywords; *k; k++) {
+                int klen = strlen(*k);
+                int kw2 = (*k)[klen - 1] == '|';
+                if (kw2) klen--;
+
+                if (len - i >= klen && !strncmp(&text[i], *k, klen)
+                        && (i + klen == len || synSeparator((unsigned char)text[i + klen]))) {
+                    memset(&hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+                    i += klen;
+                    break;
+                }
+            }
+            if (*k != NULL) {
+                sep = 0;
+                prev = hl[i - 1];
+                continue;
+            }
+        }
+
+        hl[i] = prev = HL_NORMAL;
+        sep = synSeparator(c);
+        i++;
+    }
+
+    return incomment ? SYN_COMMENT : SYN_NORMAL;
+}
+
+// Make sure the start and end states of every row up to and including upto
+// are right. Rows whose text is unchanged and that still start in the state
+// they were lexed in are skipped over without looking at their text.
+void synUpdate(struct editorConfig *E, int upto) {
+    if (E->syntax == NULL || upto < E->hlvalid) return;
+    if (upto >= E->numrows) upto = E->numrows - 1;
+
+    int at = E->hlvalid;
+    int state = SYN_NORMAL;
+    if (at > 0) state = rsGet(&E->rows, at - 1)->hlend;
+
+    struct rsIter it;
+    erow *row = rsIterStart(&it, &E->rows, at);
+    for (; row && at <= upto; row = rsIterNext(&it), at++) {
+        if (row->hlend == SYN_STALE || row->hlin != state) {
+            row->hlin = state;
+            int len = row->size < SYN_MAXCOL ? row->size : SYN_MAXCOL;
+            row->hlend = synLex(E->syntax, eRowPrefix(at, row, len, E), len,
+                    state, NULL);
+        }
+        state = row->hlend;
+    }
+    E->hlvalid = at;
+}
+
+// screen attribute for a highlight class, the foreground colour + 1
+unsigned char synAttr(unsigned char hl) {
+    switch (hl) {
+        case HL_COMMENT:
+        case HL_MLCOMMENT: return 36 - 30 + 1;
+        case HL_KEYWORD1: return 33 - 30 + 1;
+        case HL_KEYWORD2: return 32 - 30 + 1;
+        case HL_STRING: return 35 - 30 + 1;
+        case HL_NUMBER: return 31 - 30 + 1;
+        default: return 0;
+    }
+}
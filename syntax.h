@@ -0,0 +1,54 @@
+#ifndef SYNTAX_H
+#define SYNTAX_H
+
+/*** SYNTAX ***/
+// Every row remembers the lexer state it was started in and the one it
+// ended in (inside a block comment or not). Rows from E->hlvalid on may be
+// out of date; catching up walks forward from there re-lexing only rows
+// whose text changed or whose start state no longer matches the row above,
+// so an edit that doesn't open or close a comment costs one row. Colours
+// are only worked out for rows that are about to be drawn and live in the
+// render slots next to the tab expanded text.
+#define SYN_STALE 0xff // hlend of a row whose text changed since it was lexed
+// like vim's synmaxcol, only this much of a row is lexed so editing a line
+// megabytes long doesn't mean lexing all of it each key. The rest is drawn
+// plain and the row's end state is the one this far in.
+#define SYN_MAXCOL 3000
+
+enum synState {
+    SYN_NORMAL = 0,
+    SYN_COMMENT     // inside a multi line comment
+};
+
+enum synHl {
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER
+};
+
+#define SYN_HL_NUMBERS (1 << 0)
+#define SYN_HL_STRINGS (1 << 1)
+
+struct syntax {
+    const char *filetype;
+    const char **filematch; // extensions start with a '.'
+    const char **keywords;  // type keywords end in '|'
+    const char *comment;
+    const char *mlstart;
+    const char *mlend;
+    int flags;
+    unsigned char stop[256]; // bytes that can start something stateful
+};
+
+struct editorConfig;
+
+struct syntax *synSelect(const char *filename);
+int synLex(struct syntax *syn, const char *text, int len, int state,
+        unsigned char *hl);
+void synUpdate(struct editorConfig *E, int upto);
+unsigned char synAttr(unsigned char hl);
+#endif
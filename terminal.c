@@ -1,8 +1,13 @@
+#define _GNU_SOURCE
+
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <termios.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 
 #include "editorconfig.h"
 #include "config.h"
@@ -14,12 +19,21 @@ void die(const char *s) {
     exit(1);
 }
 
+// the terminal settings atexit restores
+static struct termios *origTermios;
+
 void disableRawMode(struct editorConfig *E) {
-    // set the original flags back to the terminal
+    // bracketed paste off and the original flags back to the terminal
+    write(STDOUT_FILENO, "\x1b[?2004l", 8);
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E->origTermios) == -1)
         die("tcsetattr");
 }
 
+static void eRestoreTerminal() {
+    write(STDOUT_FILENO, "\x1b[?2004l", 8);
+    tcsetattr(STDIN_FILENO, TCSAFLUSH, origTermios);
+}
+
 void enableRawMode(struct editorConfig *E) {
 
     // take copies of the current terminal setup
@@ -29,7 +43,8 @@ void enableRawMode(struct editorConfig *E) {
     struct termios raw = E->origTermios;
 
     // reset when we exit
-    atexit(disableRawMode);
+    origTermios = &E->origTermios;
+    atexit(eRestoreTerminal);
 
     // bit wise ANDing lflag against A NOTted ECHO flag set 
     // this allows us to unset the ECHO flag set whilst retaining the rest
@@ -50,29 +65,143 @@ void enableRawMode(struct editorConfig *E) {
     // Set the character size to 8 just incase
     raw.c_cflag |= (CS8);
 
-    // Set some control characters to allow read to timeout and not block
-    raw.c_cc[VMIN] = 0;
-    raw.c_cc[VTIME] = 1;
+    // reads block for at least a byte, but we only read once poll() says
+    // there is something there (see event.h), so they never actually wait
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
 
     if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1)
         die("tcsetattr");
+
+    // have the terminal mark pasted text with \x1b[200~ ... \x1b[201~
+    write(STDOUT_FILENO, "\x1b[?2004h", 8);
+}
+
+int getWindowSize(int *rows, int *cols) {
+    struct winsize ws;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0)
+        return -1;
+    else {
+        *cols = ws.ws_col;
+        *rows = ws.ws_row;
+        return 0;
+    }
+}
+
+// pick up the new window size after a SIGWINCH
+static void eResize(struct editorConfig *E) {
+    int rows, cols;
+    if (getWindowSize(&rows, &cols) == -1) return;
+    // status line and command line
+    E->screenrows = rows - 2;
+    E->screencols = cols;
 }
 
-int eReadKey() {
-    int nread;
+// take the next buffer full of a script as input, 0 once it's all been read
+static int eFillScript(struct input *in) {
+    size_t n = in->scriptlen - in->scriptpos;
+    if (n == 0) return 0;
+    if (n > sizeof(in->buf)) n = sizeof(in->buf);
+    memcpy(in->buf, &in->script[in->scriptpos], n);
+    in->scriptpos += n;
+    in->pos = 0;
+    in->len = n;
+    return 1;
+}
+
+// take input from keys rather than the terminal until it's called again
+// with NULL, see eRunScript
+void eReplay(struct editorConfig *E, const char *keys, size_t len) {
+    struct input *in = &E->in;
+    in->script = keys;
+    in->scriptlen = len;
+    in->scriptpos = 0;
+    in->pos = in->len = 0;
+}
+
+// fill in->buf from the terminal, waiting up to ms for something to turn up
+static int eFill(struct input *in, int ms) {
+    if (in->script) return eFillScript(in);
+
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    if (poll(&pfd, 1, ms) <= 0) return 0;
+
+    int nread = read(STDIN_FILENO, in->buf, sizeof(in->buf));
+    if (nread == -1 && errno != EAGAIN && errno != EINTR) die("read");
+    if (nread <= 0) return 0;
+    in->pos = 0;
+    in->len = nread;
+    return 1;
+}
+
+// next byte of an escape sequence already under way, 0 if the rest of it
+// doesn't turn up within 100ms, in which case it was just escape
+static int eReadByte(struct input *in, char *c) {
+    if (in->pos == in->len && !eFill(in, 100)) return 0;
+    *c = in->buf[in->pos++];
+    return 1;
+}
+
+int eReadKey(struct editorConfig *E) {
+    struct input *in = &E->in;
     char c;
     char esc = '\x1b';
 
-    while ((nread = read(STDIN_FILENO, &c, 1)) != 1) {
-        if (nread == -1 && errno != EAGAIN) die("read");
+    if (E->lat.on) latDispatched(&E->lat);
+
+    // keep the screen ticking over while a save or search runs
+    if (E->save.active || E->search.active) {
+        if (!evArmed(&E->ev, EV_TICK)) evTimer(&E->ev, EV_TICK, 100);
+    } else {
+        evTimer(&E->ev, EV_TICK, -1);
+    }
+
+    // keys already read ahead arrived along with ones handed out before
+    int fresh = in->pos == in->len || in->script;
+
+    // a script that runs out reads as escape, backing out of a half typed
+    // prompt rather than waiting on the terminal
+    if (in->script && in->pos == in->len && !eFill(in, 0)) return esc;
+
+    // sleep until there's a key, anything else makes for a redraw
+    while (in->pos == in->len) {
+        int timer;
+        switch (evWait(&E->ev, STDIN_FILENO, &timer)) {
+            case EV_INPUT:
+                // readable but nothing to read, the terminal has gone
+                if (!eFill(in, 0)) die("read");
+                break;
+            case EV_RESIZE:
+                eResize(E);
+                return TICK;
+            case EV_TIMER:
+                if (timer == EV_STATUS) E->statusmsg[0] = '\0';
+                return TICK;
+            case EV_WATCH:
+                // the file being followed changed, eFrame reads it
+                flDrain(&E->follow);
+                return TICK;
+        }
     }
+    if (E->lat.on) {
+        if (fresh) latArrived(&E->lat);
+        latKey(&E->lat);
+    }
+    c = in->buf[in->pos++];
+
     if (c == '\x1b') {
         // escape sequence?
-        char seq[3];
+        char seq[8];
 
         // check if it is, otherwise it might just be escape...
-        if (read(STDIN_FILENO, &seq[0], 1) != 1) return esc;
-        if (read(STDIN_FILENO, &seq[1], 1) != 1) return esc;
+        if (!eReadByte(in, &seq[0])) return esc;
+        if (seq[0] != '[') {
+            // escape followed by a key, typed quickly or in a script
+            in->pos--;
+            return esc;
+        }
+        if (!eReadByte(in, &seq[1])) return esc;
 
         if (seq[0] == '[') {
             // parse escape sequence
@@ -82,11 +211,76 @@ int eReadKey() {
                 case 'C': return RIGHT;
                 case 'D': return LEFT;
             }
+
+            // parameters run up to a final byte from @ to ~, which all of
+            // it is read through so none of it comes out as keys (\x1b[1;5C
+            // and the like). \x1b[200~ starts a paste.
+            if (seq[1] >= 0x20 && seq[1] < 0x40) {
+                int n = 2;
+                char b = seq[1];
+                while (b >= 0x20 && b < 0x40) {
+                    if (!eReadByte(in, &b)) return esc;
+                    if (n < (int)sizeof(seq)) seq[n++] = b;
+                }
+                // not a sequence after all, the byte is a key of its own
+                if (b < 0x40 || b > 0x7e) in->pos--;
+                else if (n == 5 && memcmp(seq, "[200~", 5) == 0) return PASTE;
+            }
         }
 
         return esc;
     } else {
-        return c;
+        // bytes of UTF-8 characters come through as 128-255
+        return (unsigned char)c;
     }
 }
 
+// the text of a paste, after eReadKey has returned PASTE, read up to the
+// closing \x1b[201~ a buffer at a time. Stops early if the terminal goes
+// quiet for a second without closing it.
+char *eReadPaste(struct editorConfig *E, size_t *len) {
+    struct input *in = &E->in;
+    static const char end[] = "\x1b[201~";
+    size_t endlen = sizeof(end) - 1;
+    size_t n = 0, cap = 64 * 1024;
+    char *buf = malloc(cap);
+
+    while (1) {
+        if (in->pos == in->len && !eFill(in, 1000)) break;
+
+        int avail = in->len - in->pos;
+        if (n + avail > cap) {
+            while (n + avail > cap) cap *= 2;
+            buf = realloc(buf, cap);
+        }
+        memcpy(&buf[n], &in->buf[in->pos], avail);
+
+        // look for the end marker from where it could have started, it may
+        // straddle two reads
+        size_t from = n >= endlen ? n - endlen + 1 : 0;
+        n += avail;
+        in->pos = in->len;
+        char *hit = memmem(&buf[from], n - from, end, endlen);
+        if (hit) {
+            // anything after the marker is typed input, hand it back
+            size_t after = n - (hit - buf) - endlen;
+            memmove(in->buf, hit + endlen, after);
+            in->pos = 0;
+            in->len = after;
+            n = hit - buf;
+            break;
+        }
+    }
+
+    *len = n;
+    return buf;
+}
+
+// is there a key waiting to be read
+int eInputPending(struct editorConfig *E) {
+    struct input *in = &E->in;
+    if (in->pos < in->len) return 1;
+    if (in->script) return in->scriptpos < in->scriptlen;
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&pfd, 1, 0) > 0;
+}
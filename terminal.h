@@ -1,6 +1,10 @@
 #include "editorconfig.h"
 
 void die(const char *s);
+int getWindowSize(int *rows, int *cols);
 void disableRawMode(struct editorConfig *E);
 void enableRawMode(struct editorConfig *E);
-int eReadKey();
+int eReadKey(struct editorConfig *E);
+char *eReadPaste(struct editorConfig *E, size_t *len);
+int eInputPending(struct editorConfig *E);
+void eReplay(struct editorConfig *E, const char *keys, size_t len);
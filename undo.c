@@ -0,0 +1,236 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "editorconfig.h"
+#include "row.h"
+#include "undo.h"
+
+// let go of whatever the record holds
+static void unDrop(struct editorConfig *E, struct unRec *r) {
+    arFree(&E->arena, r->text, r->cap);
+    if (r->rows) eRowsRelease(r->rows, r->len, E);
+    E->undo.bytes -= r->bytes;
+}
+
+void unInit(struct undoLog *u) {
+    u->rec = NULL;
+    u->n = u->cap = 0;
+    u->pos = 0;
+    u->seq = 0;
+    u->open = 0;
+    u->replaying = 0;
+    u->bytes = 0;
+}
+
+// drop every record, the rows they hold included
+void unFree(struct editorConfig *E) {
+    struct undoLog *u = &E->undo;
+    int i;
+    for (i = 0; i < u->n; i++)
+        unDrop(E, &u->rec[i]);
+    free(u->rec);
+    unInit(u);
+}
+
+// the next change made starts a new undo step
+void unStep(struct undoLog *u) {
+    u->seq++;
+}
+
+// a new record for the next change, dropping whatever could be redone and,
+// once the log is over budget, the oldest records
+static struct unRec *unPush(struct editorConfig *E, int type, int row, int col) {
+    struct undoLog *u = &E->undo;
+    int i;
+
+    for (i = u->pos; i < u->n; i++)
+        unDrop(E, &u->rec[i]);
+    u->n = u->pos;
+
+    if (u->bytes > ENVY_UNDO_BYTES) {
+        // drop down to 3/4 of the budget so this doesn't happen every edit
+        int old = 0;
+        while (old < u->n && u->bytes > ENVY_UNDO_BYTES / 4 * 3)
+            unDrop(E, &u->rec[old++]);
+        memmove(u->rec, &u->rec[old], sizeof(struct unRec) * (u->n - old));
+        u->n -= old;
+    }
+
+    if (u->n == u->cap) {
+        u->cap = u->cap ? u->cap * 2 : 64;
+        u->rec = realloc(u->rec, sizeof(struct unRec) * u->cap);
+    }
+
+    struct unRec *r = &u->rec[u->n++];
+    u->pos = u->n;
+    r->type = type;
+    r->seq = u->seq;
+    r->row = row;
+    r->col = col;
+    r->len = 0;
+    r->text = NULL;
+    r->cap = 0;
+    r->rows = NULL;
+    r->cx = E->cx;
+    r->cy = E->cy;
+    r->bytes = sizeof(struct unRec);
+    u->bytes += r->bytes;
+    return r;
+}
+
+// append (or with front set, prepend) len bytes of s to the record's text
+static void unAddText(struct editorConfig *E, struct unRec *r, const char *s,
+        int len, int front) {
+    int oldcap = r->cap;
+    r->text = arRealloc(&E->arena, r->text, r->cap, r->len + len, &r->cap);
+    if (front) memmove(&r->text[len], r->text, r->len);
+    memcpy(front ? r->text : &r->text[r->len], s, len);
+    r->len += len;
+    r->bytes += r->cap - oldcap;
+    E->undo.bytes += r->cap - oldcap;
+}
+
+// log len bytes of s being put in (UN_INSERT) or taken out (UN_DELETE) of
+// row at col
+void unText(struct editorConfig *E, int type, int row, int col,
+        const char *s, int len) {
+    struct undoLog *u = &E->undo;
+    if (u->replaying || len <= 0) return;
+
+    struct unRec *r = u->open && u->pos == u->n && u->n ? &u->rec[u->n - 1] : NULL;
+    if (r && r->type == type && r->row == row && len == 1) {
+        // typing on from the end of the last insert, or deleting on from
+        // either side of the last delete (x from the front, backspace from
+        // the back)
+        if (type == UN_INSERT && col == r->col + r->len) {
+            unAddText(E, r, s, len, 0);
+            return;
+        }
+        if (type == UN_DELETE && col == r->col) {
+            unAddText(E, r, s, len, 0);
+            return;
+        }
+        if (type == UN_DELETE && col + len == r->col) {
+            unAddText(E, r, s, len, 1);
+            r->col = col;
+            return;
+        }
+    }
+
+    r = unPush(E, type, row, col);
+    unAddText(E, r, s, len, 0);
+    u->open = 1;
+}
+
+// log n rows being put in at row (UN_ADDROWS, rows NULL) or taken out
+// (UN_DELROWS), in which case the record takes rows over. Returns 0 if the
+// rows weren't taken.
+int unRows(struct editorConfig *E, int type, int row, erow *rows, int n) {
+    struct undoLog *u = &E->undo;
+    if (u->replaying || n <= 0) return 0;
+    u->open = 0;
+
+    // consecutive rows going in or out as part of the same step (a paste,
+    // a counted delete) make one record
+    struct unRec *r = u->pos == u->n && u->n ? &u->rec[u->n - 1] : NULL;
+    if (r && r->seq == u->seq && r->type == type) {
+        if (type == UN_ADDROWS && row == r->row + r->len) {
+            r->len += n;
+            return 1;
+        }
+        if (type == UN_DELROWS && row == r->row) {
+            r->rows = realloc(r->rows, sizeof(erow) * (r->len + n));
+            memcpy(&r->rows[r->len], rows, sizeof(erow) * n);
+            free(rows);
+            r->len += n;
+            r->bytes += sizeof(erow) * n;
+            u->bytes += sizeof(erow) * n;
+            return 1;
+        }
+    }
+
+    r = unPush(E, type, row, 0);
+    r->len = n;
+    r->rows = rows;
+    if (rows) {
+        int i;
+        size_t bytes = sizeof(erow) * n;
+        for (i = 0; i < n; i++) bytes += rows[i].cap;
+        r->bytes += bytes;
+        u->bytes += bytes;
+    }
+    return 1;
+}
+
+// do (redo set) or undo one record
+static void unApply(struct editorConfig *E, struct unRec *r, int redo) {
+    int type = r->type;
+    if (!redo) {
+        switch (type) {
+            case UN_INSERT: type = UN_DELETE; break;
+            case UN_DELETE: type = UN_INSERT; break;
+            case UN_ADDROWS: type = UN_DELROWS; break;
+            case UN_DELROWS: type = UN_ADDROWS; break;
+        }
+    }
+
+    switch (type) {
+        case UN_INSERT:
+            eRowInsert(r->row, r->col, r->text, r->len, E);
+            break;
+        case UN_DELETE:
+            eRowDelete(r->row, r->col, r->len, E);
+            break;
+        case UN_ADDROWS:
+            ePutRows(r->row, r->rows, r->len, E);
+            free(r->rows);
+            r->rows = NULL;
+            break;
+        case UN_DELROWS:
+            r->rows = eTakeRows(r->row, r->len, E);
+            break;
+    }
+}
+
+static void unCursor(struct editorConfig *E, int cx, int cy) {
+    if (cy >= E->numrows) cy = E->numrows ? E->numrows - 1 : 0;
+    erow *row = rsGet(&E->rows, cy);
+    if (row == NULL || cx > row->size) cx = row ? row->size : 0;
+    E->cx = cx;
+    E->cy = cy;
+}
+
+// undo the last step, 0 if there is nothing to undo
+int unUndo(struct editorConfig *E) {
+    struct undoLog *u = &E->undo;
+    if (u->pos == 0) return 0;
+
+    unsigned seq = u->rec[u->pos - 1].seq;
+    struct unRec *r = NULL;
+    u->replaying = 1;
+    while (u->pos > 0 && u->rec[u->pos - 1].seq == seq) {
+        r = &u->rec[--u->pos];
+        unApply(E, r, 0);
+    }
+    u->replaying = 0;
+    u->open = 0;
+    unCursor(E, r->cx, r->cy);
+    return 1;
+}
+
+// redo the last step undone, 0 if there is nothing to redo
+int unRedo(struct editorConfig *E) {
+    struct undoLog *u = &E->undo;
+    if (u->pos == u->n) return 0;
+
+    unsigned seq = u->rec[u->pos].seq;
+    struct unRec *first = &u->rec[u->pos];
+    u->replaying = 1;
+    while (u->pos < u->n && u->rec[u->pos].seq == seq)
+        unApply(E, &u->rec[u->pos++], 1);
+    u->replaying = 0;
+    u->open = 0;
+    unCursor(E, first->cx, first->cy);
+    return 1;
+}
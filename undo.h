@@ -0,0 +1,55 @@
+#ifndef UNDO_H
+#define UNDO_H
+
+#include <stddef.h>
+
+#include "erow.h"
+
+/*** UNDO ***/
+// Every change row.c makes to the buffer is logged so it can be undone and
+// redone. A typed character or backspace that carries on where the last
+// record left off extends that record, so a run of typing is one record.
+// Deleted rows are moved into their record whole, text and all, without a
+// copy, and undoing that hands the same rows back to the row store in one
+// splice. Text held by records lives in the row arena. Once the log holds
+// more than ENVY_UNDO_BYTES the oldest records are dropped.
+enum unType {
+    UN_INSERT,  // text put in at row, col
+    UN_DELETE,  // text taken out at row, col
+    UN_ADDROWS, // len rows put in at row
+    UN_DELROWS  // len rows taken out at row
+};
+
+struct unRec {
+    int type;
+    unsigned seq;   // records sharing a seq are undone as one step
+    int row, col;
+    int len;        // bytes of text or number of rows
+    char *text;
+    int cap;        // arena capacity of text
+    erow *rows;     // the rows while they are out of the buffer
+    int cx, cy;     // cursor before the change
+    size_t bytes;   // what the record holds on to, roughly
+};
+
+struct undoLog {
+    struct unRec *rec;
+    int n, cap;
+    int pos;        // rec[0..pos) can be undone, rec[pos..n) redone
+    unsigned seq;
+    int open;       // the last record may be extended by the next edit
+    int replaying;  // applying the log, which mustn't log itself
+    size_t bytes;
+};
+
+struct editorConfig;
+
+void unInit(struct undoLog *u);
+void unFree(struct editorConfig *E);
+void unStep(struct undoLog *u);
+void unText(struct editorConfig *E, int type, int row, int col,
+        const char *s, int len);
+int unRows(struct editorConfig *E, int type, int row, erow *rows, int n);
+int unUndo(struct editorConfig *E);
+int unRedo(struct editorConfig *E);
+#endif
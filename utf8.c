@@ -0,0 +1,139 @@
+#include "utf8.h"
+
+// decode the character at s, returns how many bytes it took up. Anything
+// malformed is one byte decoded as U+FFFD.
+int u8Decode(const char *s, int len, int *cp) {
+    const unsigned char *u = (const unsigned char *)s;
+    int n, c, i;
+
+    if (len <= 0) {
+        *cp = 0;
+        return 0;
+    }
+    if (u[0] < 0x80) {
+        *cp = u[0];
+        return 1;
+    }
+
+    if ((u[0] & 0xe0) == 0xc0) {
+        n = 2;
+        c = u[0] & 0x1f;
+    } else if ((u[0] & 0xf0) == 0xe0) {
+        n = 3;
+        c = u[0] & 0x0f;
+    } else if ((u[0] & 0xf8) == 0xf0) {
+        n = 4;
+        c = u[0] & 0x07;
+    } else {
+        *cp = 0xfffd;
+        return 1;
+    }
+    if (n > len) {
+        *cp = 0xfffd;
+        return 1;
+    }
+    for (i = 1; i < n; i++) {
+        if ((u[i] & 0xc0) != 0x80) {
+            *cp = 0xfffd;
+            return 1;
+        }
+        c = (c << 6) | (u[i] & 0x3f);
+    }
+
+    // overlong encodings, surrogates and past the end of unicode
+    if ((n == 2 && c < 0x80) || (n == 3 && c < 0x800) || (n == 4 && c < 0x10000)
+            || (c >= 0xd800 && c <= 0xdfff) || c > 0x10ffff) {
+        *cp = 0xfffd;
+        return 1;
+    }
+    *cp = c;
+    return n;
+}
+
+struct u8Range {
+    int first, last;
+};
+
+// combining marks and other characters that take no room of their own
+static const struct u8Range u8Zero[] = {
+    { 0x0300, 0x036f }, { 0x0483, 0x0489 }, { 0x0591, 0x05bd },
+    { 0x05bf, 0x05bf }, { 0x05c1, 0x05c2 }, { 0x05c4, 0x05c5 },
+    { 0x05c7, 0x05c7 }, { 0x0610, 0x061a }, { 0x064b, 0x065f },
+    { 0x0670, 0x0670 }, { 0x06d6, 0x06dc }, { 0x06df, 0x06e4 },
+    { 0x06e7, 0x06e8 }, { 0x06ea, 0x06ed }, { 0x0711, 0x0711 },
+    { 0x0730, 0x074a }, { 0x07a6, 0x07b0 }, { 0x0900, 0x0902 },
+    { 0x093a, 0x093a }, { 0x093c, 0x093c }, { 0x0941, 0x0948 },
+    { 0x094d, 0x094d }, { 0x0951, 0x0957 }, { 0x0e31, 0x0e31 },
+    { 0x0e34, 0x0e3a }, { 0x0e47, 0x0e4e }, { 0x1ab0, 0x1aff },
+    { 0x1dc0, 0x1dff }, { 0x200b, 0x200f }, { 0x202a, 0x202e },
+    { 0x2060, 0x2064 }, { 0x20d0, 0x20ff }, { 0xfe00, 0xfe0f },
+    { 0xfe20, 0xfe2f }, { 0xfeff, 0xfeff }, { 0xe0100, 0xe01ef }
+};
+
+// characters drawn two columns wide
+static const struct u8Range u8Wide[] = {
+    { 0x1100, 0x115f }, { 0x231a, 0x231b }, { 0x2329, 0x232a },
+    { 0x23e9, 0x23ec }, { 0x23f0, 0x23f0 }, { 0x23f3, 0x23f3 },
+    { 0x25fd, 0x25fe }, { 0x2614, 0x2615 }, { 0x2648, 0x2653 },
+    { 0x267f, 0x267f }, { 0x2693, 0x2693 }, { 0x26a1, 0x26a1 },
+    { 0x26aa, 0x26ab }, { 0x26bd, 0x26be }, { 0x26c4, 0x26c5 },
+    { 0x26ce, 0x26ce }, { 0x26d4, 0x26d4 }, { 0x26ea, 0x26ea },
+    { 0x26f2, 0x26f3 }, { 0x26f5, 0x26f5 }, { 0x26fa, 0x26fa },
+    { 0x26fd, 0x26fd }, { 0x2705, 0x2705 }, { 0x270a, 0x270b },
+    { 0x2728, 0x2728 }, { 0x274c, 0x274c }, { 0x274e, 0x274e },
+    { 0x2753, 0x2755 }, { 0x2757, 0x2757 }, { 0x2795, 0x2797 },
+    { 0x27b0, 0x27b0 }, { 0x27bf, 0x27bf }, { 0x2b1b, 0x2b1c },
+    { 0x2b50, 0x2b50 }, { 0x2b55, 0x2b55 }, { 0x2e80, 0x303e },
+    { 0x3041, 0x33ff }, { 0x3400, 0x4dbf }, { 0x4e00, 0x9fff },
+    { 0xa000, 0xa4cf }, { 0xa960, 0xa97f }, { 0xac00, 0xd7a3 },
+    { 0xf900, 0xfaff }, { 0xfe10, 0xfe19 }, { 0xfe30, 0xfe6f },
+    { 0xff00, 0xff60 }, { 0xffe0, 0xffe6 }, { 0x1f300, 0x1f64f },
+    { 0x1f680, 0x1f6ff }, { 0x1f900, 0x1f9ff }, { 0x1fa70, 0x1faff },
+    { 0x20000, 0x2fffd }, { 0x30000, 0x3fffd }
+};
+
+static int u8In(const struct u8Range *r, int n, int cp) {
+    int lo = 0, hi = n - 1;
+    if (cp < r[0].first || cp > r[n - 1].last) return 0;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (cp > r[mid].last) lo = mid + 1;
+        else if (cp < r[mid].first) hi = mid - 1;
+        else return 1;
+    }
+    return 0;
+}
+
+// columns cp takes up on screen
+int u8Width(int cp) {
+    if (cp < 0x300) return 1;
+    if (u8In(u8Zero, sizeof(u8Zero) / sizeof(u8Zero[0]), cp)) return 0;
+    if (u8In(u8Wide, sizeof(u8Wide) / sizeof(u8Wide[0]), cp)) return 2;
+    return 1;
+}
+
+// index of the character after the one at s[i], adding its width to *col
+int u8Step(const char *s, int len, int i, int *col) {
+    if ((unsigned char)s[i] < 0x80) {
+        (*col)++;
+        return i + 1;
+    }
+    int cp;
+    int n = u8Decode(&s[i], len - i, &cp);
+    *col += u8Width(cp);
+    return i + n;
+}
+
+// index of the character before s[i]
+int u8Prev(const char *s, int i) {
+    int start = i;
+    if (i <= 0) return 0;
+    i--;
+    // back over continuation bytes, but no further than a character can be
+    while (i > 0 && start - i < U8_MAX && ((unsigned char)s[i] & 0xc0) == 0x80)
+        i--;
+    // and if they don't lead back to a character they stand on their own
+    int cp;
+    if (i + u8Decode(&s[i], start - i, &cp) != start) return start - 1;
+    return i;
+}
@@ -0,0 +1,16 @@
+#ifndef UTF8_H
+#define UTF8_H
+
+/*** UTF-8 ***/
+// Rows are kept as the bytes from the file and cx is a byte offset into
+// them, so all that's needed is stepping over whole characters and how
+// many columns each one takes on screen: 0 for combining marks, 2 for wide
+// east asian characters and emoji, 1 for the rest. Bytes that aren't valid
+// UTF-8 are taken one at a time and shown one column wide.
+#define U8_MAX 4 // bytes in the longest character
+
+int u8Decode(const char *s, int len, int *cp);
+int u8Width(int cp);
+int u8Step(const char *s, int len, int i, int *col);
+int u8Prev(const char *s, int i);
+#endif